@@ -6,6 +6,7 @@ STUDENTREPO="520-Assignments"                # the name of the student's repo
 DIR=$PWD                            # current working directory
 RESULTS="$DIR/results"              # output directory for results
 DUEDATE=""                          # the due date of the homework
+WORKTREES="$DIR/$STUDENTDIR/.worktrees" # due date snapshots of student repos, one per grading job
 
 GRADING=$PWD/grading                # path to grading directory, should contain makefile, main, and unit_test
 TESTVER=""
@@ -13,11 +14,25 @@ MAKE="MakefileGrade$TESTVER"        # name of the makefile to use for compiling
 TEST="unit_tests_grading*.c"        # name of the unit_test file
 MAIN="main_grading.c"               # name of the main file for tests
 
+FUZZSECONDS=""                      # if set, fuzz student parsers for this many seconds per target
+ALLOCSTATS=0                        # if 1, count heap allocations per test
+TIMING=0                            # if 1, also run the wall-clock complexity tests
+UNITY=0                             # if 1, build the student sources as one translation unit
+
 SUMMARY="$RESULTS/summary.csv"
+RESULTSDB="$RESULTS/results.db"     # grades and per test results of every run, see results.sh
+RUNID="$(date +%Y-%m-%dT%H:%M:%S)"  # identifies this run in the results database
+DBTIMEOUT=10000                     # ms to wait for another grade.sh writing the results database
+DBRETRIES=3                         # attempts at a write that still finds the database locked
+TESTRESULTS="TestResults.tsv"       # per test results written by main.cc
+OUTCOMEMATRIX="$PWD/tools/bin/outcome_matrix" # packs the per test results, built with 'make -C tools'
+COMPACTLOG="$PWD/tools/bin/compact_log" # compacts and expands logs, built with 'make -C tools'
+COMPACT=0                           # if 1, write compact gzipped logs
+PROGRESSDIR="$RESULTS/progress"     # progress events of the running jobs, <HW>/<run>/run.events and <HW>/<run>/<login>.events
 GRADEPATTERN="HOMEWORK_GRADE:" # pattern to look for from main.c to build the summary
 
 ###### OPTIONS ######
-while getopts i:h:l:v:a:d: option
+while getopts i:h:l:v:a:d:z:m:t:r:k:u: option
 do
 case "${option}"
 in
@@ -27,6 +42,12 @@ l) login=${OPTARG};;    # optionally provide a single login to evalute just one
 v) TESTVER=${OPTARG};;
 a) APPEND=${OPTARG};;   # if 1, appends result to tmp and results folders
 d) DUEDATE=${OPTARG};;  # due date for the homework
+z) FUZZSECONDS=${OPTARG};; # fuzzing budget in seconds per target
+m) ALLOCSTATS=${OPTARG};;  # if 1, report heap allocations per test
+t) TIMING=${OPTARG};;   # if 1, run the timing tests
+r) RUNID=${OPTARG};;    # name of this run in the results database
+k) COMPACT=${OPTARG};;  # if 1, logs are <login>.compact.gz instead of <login>.out
+u) UNITY=${OPTARG};;    # if 1, unity build of the student sources
 esac
 done
 shift $((OPTIND -1))
@@ -38,6 +59,12 @@ function usage() {
     echo "-i   Filepath of csv of all students [LAST_NAME,FIRST_NAME,GITHUB_LOGIN]"
     echo "-a   If 1, append student results to results dictionary. If 0, rm -rf results dictionary"
     echo "-d   The due date for the assignment e.g. '2019-01-21'"
+    echo "-z   Fuzz the student's parsers for this many seconds per target (optional)"
+    echo "-m   If 1, count heap allocations per test and run the allocation tests (optional)"
+    echo "-t   If 1, run the wall-clock complexity tests (optional)"
+    echo "-r   Name of this run in $RESULTSDB (optional, default the current time)"
+    echo "-k   If 1, write compact gzipped logs, see tools/compact_log.cc (optional)"
+    echo "-u   If 1, compile the student sources as one translation unit (optional)"
 }
 
 if ! [[ $HWDIR ]];
@@ -47,39 +74,210 @@ then
     exit 1
 fi
 
+if [[ $COMPACT == 1 && ! -x $COMPACTLOG ]];
+then
+    echo "OPPS! Compact logs need $COMPACTLOG. Please run 'make -C tools' first."
+    exit 1
+fi
+
+# the make flags that add tests to the default set; the grades of runs with
+# any of them are diagnostic and left out of the summary
+TESTFLAGS=""
+if [[ $FUZZSECONDS ]];
+then
+    TESTFLAGS="$TESTFLAGS FUZZ=1 FUZZ_SECONDS=$FUZZSECONDS"
+fi
+if [[ $ALLOCSTATS == 1 ]];
+then
+    TESTFLAGS="$TESTFLAGS ALLOC_STATS=1"
+fi
+if [[ $TIMING == 1 ]];
+then
+    TESTFLAGS="$TESTFLAGS TIMING=1"
+fi
+TESTFLAGS="${TESTFLAGS# }"
+
 function no_white_space() {
     NO_WHITESPACE="$(echo "${1}" | tr -d '[:space:]')"
     echo $NO_WHITESPACE
 }
 
+# appends stdin to the student's log
+function save_log() {
+  if [[ $COMPACT == 1 ]];
+  then
+    # each append is a gzip member of its own; gzip -d reads them back as one stream
+    $COMPACTLOG compact | gzip >> $OUT
+  else
+    cat >> $OUT
+  fi
+}
+
+function read_log() {
+  if [[ $COMPACT == 1 ]];
+  then
+    gzip -dc $OUT | $COMPACTLOG expand
+  else
+    cat $OUT
+  fi
+}
+
+# progress <event> [<details>...]
+# Adds a line to the events of this run, see progress.sh
+function progress() {
+  (IFS=$'\t'; echo "$(date +%s)"$'\t'"$*") >> $PROGRESSRUN/run.events
+}
+
+# quotes a string for sql
+function sql_quote() {
+    printf "'%s'" "${1//\'/\'\'}"
+}
+
+# write_db
+# Runs the sql on stdin against the results database as one transaction.
+# Concurrent grade.sh runs (each grading in worktrees of its own) share the
+# database, so a write waits up to DBTIMEOUT ms for the lock and is retried
+# if it still fails; a failed attempt is rolled back as a whole.
+function write_db() {
+  sql="$(cat)"
+  for try in $(seq 1 $DBRETRIES);
+  do
+    if printf '%s\n' "BEGIN IMMEDIATE;" "$sql" "COMMIT;" | sqlite3 -bail -cmd ".timeout $DBTIMEOUT" $RESULTSDB;
+    then
+      return 0
+    fi
+    echo "WARNING: writing $RESULTSDB failed (attempt $try of $DBRETRIES)"
+    sleep $try
+  done
+  echo "OPPS! Could not write to $RESULTSDB"
+  return 1
+}
+
+function init_db() {
+  write_db <<EOF
+CREATE TABLE IF NOT EXISTS runs (run TEXT, homework TEXT, duedate TEXT, started TEXT, flags TEXT,
+    PRIMARY KEY (run, homework));
+CREATE TABLE IF NOT EXISTS grades (run TEXT, homework TEXT, login TEXT, fname TEXT, lname TEXT,
+    passed INTEGER, total INTEGER, failure TEXT, digest TEXT, PRIMARY KEY (run, homework, login));
+CREATE TABLE IF NOT EXISTS tests (run TEXT, homework TEXT, login TEXT, test TEXT, passed INTEGER, ms INTEGER,
+    allocations INTEGER, alloc_bytes INTEGER, alloc_peak INTEGER, PRIMARY KEY (run, homework, login, test));
+CREATE INDEX IF NOT EXISTS tests_by_test ON tests (homework, test, passed);
+EOF
+  # databases from before digests, allocation counts and flags were kept
+  add_column grades digest TEXT
+  add_column tests allocations INTEGER
+  add_column tests alloc_bytes INTEGER
+  add_column tests alloc_peak INTEGER
+  add_column runs flags TEXT
+  write_db <<EOF
+INSERT OR REPLACE INTO runs (run, homework, duedate, started, flags)
+    VALUES ($(sql_quote "$RUNID"), $(sql_quote "$HWDIR"), $(sql_quote "$DUEDATE"), datetime('now'), $(sql_quote "$TESTFLAGS"));
+EOF
+}
+
+# add_column <table> <column> <type>
+# Adds the column to a database created before it existed
+function add_column() {
+  if [[ "$(sqlite3 -cmd ".timeout $DBTIMEOUT" $RESULTSDB "SELECT count(*) FROM pragma_table_info('$1') WHERE name = '$2'")" == "0" ]];
+  then
+    # another grade.sh starting at the same time may add it first
+    error="$(sqlite3 -cmd ".timeout $DBTIMEOUT" $RESULTSDB "ALTER TABLE $1 ADD COLUMN $2 $3;" 2>&1)"
+    if [[ $error && $error != *"duplicate column name"* ]];
+    then
+      echo "WARNING: could not add $1.$2 to $RESULTSDB: $error"
+    fi
+  fi
+}
+
+# record_results <tsv file>
+# Replaces this run's grade and test results for the student
+function record_results() {
+  key="$(sql_quote "$RUNID"), $(sql_quote "$HWDIR"), $(sql_quote "$login")"
+  passed="${grade%/*}"
+  total="${grade#*/}"
+  failed="NULL"
+  [[ $failure ]] && failed="$(sql_quote "$failure")"
+  # same digest, same outcome of every test; lets results.sh diff-runs skip the student
+  digest="NULL"
+  [[ -e $1 ]] && digest="$(sql_quote "$(cut -f 1,2 $1 | sort | git hash-object --stdin)")"
+  {
+    echo "INSERT OR REPLACE INTO grades (run, homework, login, fname, lname, passed, total, failure, digest)"
+    echo "    VALUES ($key, $(sql_quote "$fname"), $(sql_quote "$lname"), ${passed:-NULL}, ${total:-NULL}, $failed, $digest);"
+    echo "DELETE FROM tests WHERE run = $(sql_quote "$RUNID") AND homework = $(sql_quote "$HWDIR") AND login = $(sql_quote "$login");"
+    if [[ -e $1 ]];
+    then
+      echo "CREATE TEMP TABLE imported (test TEXT, passed INTEGER, ms INTEGER, allocations INTEGER,"
+      echo "    alloc_bytes INTEGER, alloc_peak INTEGER);"
+      echo ".mode tabs"
+      echo ".import $1 imported"
+      # the allocation counts are empty unless built with ALLOC_STATS=1
+      echo "INSERT INTO tests (run, homework, login, test, passed, ms, allocations, alloc_bytes, alloc_peak)"
+      echo "    SELECT $key, test, passed, ms, NULLIF(allocations, ''), NULLIF(alloc_bytes, ''), NULLIF(alloc_peak, '')"
+      echo "    FROM imported;"
+    fi
+  } | write_db
+}
+
+# The latest grade of every student for every homework, in the old summary.csv format.
+# Runs with TESTFLAGS graded a different set of tests and are skipped.
+function write_summary() {
+  sqlite3 -csv -cmd ".timeout $DBTIMEOUT" $RESULTSDB > $SUMMARY <<EOF
+SELECT g.fname, g.lname, g.login, g.passed || '/' || g.total, g.failure
+FROM grades g JOIN runs r ON r.run = g.run AND r.homework = g.homework
+WHERE r.rowid = (SELECT max(r2.rowid) FROM grades g2 JOIN runs r2 ON r2.run = g2.run AND r2.homework = g2.homework
+                 WHERE g2.homework = g.homework AND g2.login = g.login AND IFNULL(r2.flags, '') = '')
+ORDER BY g.homework, g.login;
+EOF
+}
+
 function evaluate() {
   echo "\nEvaluating $1 $2 ($3)"
   lname=$(no_white_space $1)
   fname=$(no_white_space $2)
   login=$(no_white_space $3)
+  rm -f $PROGRESSRUN/$login.events
+  progress student_start $login
 
   cd $DIR
   OUTDIR="${RESULTS}/${HWDIR}"
   mkdir -p $OUTDIR
   OUT="${OUTDIR}/${login}.out"
+  if [[ $COMPACT == 1 ]];
+  then
+    OUT="${OUTDIR}/${login}.compact.gz"
+  fi
+  rm -f $OUTDIR/${login}.tsv
+  grade=""
   echo "Student : ${fname} ${lname} (${login})" #> $OUT
   echo "Github  : ${login}" #>> $OUT
   echo "Course  : ${CLASSREPO}" #>> $OUT
   echo "Homework: ${HWDIR}" #>> $OUT
   echo "\nEVALUATION:" #>> $OUT
 
-  # checkout code before due date
+  # check out the code before the due date into a worktree of its own, so the
+  # student's clone is left as it is and other jobs can grade from it at once
   echo "Checking out master branch before due date $DUEDATE"
-  curr=$PWD
-  cd $STUDENTDIR/$login
-  git checkout "`git rev-list master -n 1 --first-parent --before=$DUEDATE --date=local`"
-  cd $curr
+  STUDENTREPODIR=$STUDENTDIR/$login
+  STUDENTTARGET=""
+  WORKTREE=""
+  if [[ -e $STUDENTREPODIR ]];
+  then
+    git -C $STUDENTREPODIR worktree prune
+    commit="`git -C $STUDENTREPODIR rev-list master -n 1 --first-parent --before=$DUEDATE --date=local`"
+    WORKTREE=$WORKTREES/$login-$HWDIR-$$
+    mkdir -p $WORKTREES
+    git -C $STUDENTREPODIR worktree add --detach $WORKTREE $commit
+    if [[ $? -ne 0 ]];
+    then
+      WORKTREE=""
+    fi
+  fi
 
-  STUDENTMAIN=$STUDENTDIR/$login/$HWDIR
+  STUDENTMAIN=$WORKTREE/$HWDIR
   echo $STUDENTMAIN
-  if [[ -e $STUDENTMAIN ]];
+  if [[ $WORKTREE && -e $STUDENTMAIN ]];
   then
-    STUDENTTARGET=$STUDENTDIR/$login/$HWDIR
+    STUDENTTARGET=$STUDENTMAIN
   fi
 
   echo "INFO ($login): $STUDENTTARGET"
@@ -92,6 +290,7 @@ function evaluate() {
     echo "Coping grading file to $STUDENTTARGET"
     cd $STUDENTTARGET
     cp $GRADING/$HWDIR/* .
+    cp $GRADING/common/* .
 
     # TODO:
     # Need to use variables for this
@@ -103,34 +302,75 @@ function evaluate() {
 
     # To execute this script on a git bash terminal running on a windows 10 machine, use /$PWD:
     # On a linux machine, use $PWD:
-    CONTAINERID="$(docker run -v /$PWD:/source -di klavins/520w20:cpp)"
+    CONTAINERID="$(docker run -v /$PWD:/source -v /$PROGRESSRUN:/progress -di klavins/520w20:cpp)"
     echo "Docker container created with id $CONTAINERID"
 
     # does it compile?
-    echo "\n=== COMPILES? ===" >> $OUT
+    echo "\n=== COMPILES? ===" | save_log
     echo "INFO ($login): Checking compilation"
-    docker exec $CONTAINERID make -f $MAKE spotless >> $OUT
-    docker exec $CONTAINERID make -f $MAKE >> $OUT
-    failure="$(grep -i "failed" $OUT)"
+    progress phase $login compile
+    docker exec $CONTAINERID make -f $MAKE spotless | save_log
+    BUILDFLAGS="$TESTFLAGS"
+    if [[ $FUZZSECONDS ]];
+    then
+        rm -f FuzzCrashes.txt
+    fi
+    if [[ $UNITY == 1 ]];
+    then
+        BUILDFLAGS="$BUILDFLAGS UNITY=1"
+    fi
+    docker exec $CONTAINERID make -f $MAKE $BUILDFLAGS | save_log
+    failure="$(read_log | grep -i "failed")"
 
     # does it pass the tests
-    echo "\n=== PASSES TESTS? ===" >> $OUT
+    echo "\n=== PASSES TESTS? ===" | save_log
     echo "INFO ($login): Checking compilation"
-    docker exec $CONTAINERID ./bin/test >> $OUT
+    progress phase $login test
+    docker exec -e GRADE_PROGRESS=/progress/$login.events $CONTAINERID ./bin/test | save_log
+
+    if [[ -e $TESTRESULTS ]];
+    then
+        cp $TESTRESULTS $OUTDIR/${login}.tsv
+    fi
+
+    if [[ -e FuzzCrashes.txt ]];
+    then
+        mkdir -p $OUTDIR/fuzz
+        cp FuzzCrashes.txt $OUTDIR/fuzz/${login}.txt
+    fi
 
     # save summary of grades
-    grade="$(grep -i $GRADEPATTERN $OUT | cut -d' ' -f 2)"
+    grade="$(read_log | grep -i $GRADEPATTERN | tail -n 1 | cut -d' ' -f 2)"
+
+    progress phase $login cleanup
+    # the build output belongs to the container's user, so remove it from inside
+    docker exec $CONTAINERID make -f $MAKE spotless > /dev/null
 
     echo "Force removing container $CONTAINERID"
     docker rm -f $CONTAINERID
+    cd $DIR
   else
-    echo "Homework directory '$STUDENTTARGET' not found!"
-    errmsg="ERROR: Homework directory $STUDENTTARGET not found"
+    echo "Homework directory '$STUDENTREPODIR/$HWDIR' not found!"
+    errmsg="ERROR: Homework directory $STUDENTREPODIR/$HWDIR not found"
     failure=$errmsg
-    echo $errmsg >> $OUT
+    echo $errmsg | save_log
+  fi
+
+  if [[ $WORKTREE ]];
+  then
+    echo "Removing worktree $WORKTREE"
+    git -C $STUDENTREPODIR worktree remove --force $WORKTREE || echo "WARNING: Could not remove $WORKTREE"
+    git -C $STUDENTREPODIR worktree prune
   fi
 
-  echo "$fname,$lname,$login,$grade,$failure" >> $SUMMARY
+  if [[ $USEDB == 1 ]];
+  then
+    record_results $OUTDIR/${login}.tsv || echo "WARNING: the results of $login are only in $OUTDIR"
+  elif ! [[ $TESTFLAGS ]];
+  then
+    echo "$fname,$lname,$login,$grade,$failure" >> $SUMMARY
+  fi
+  progress student_end $login $grade
 }
 
 ###### EVALUATION ######
@@ -141,6 +381,29 @@ then
     [[ -e $RESULTS ]] && rm -rf $RESULTS
     touch $SUMMARY
 fi
+mkdir -p $RESULTS
+if command -v sqlite3 > /dev/null;
+then
+    USEDB=1
+    init_db
+else
+    echo "WARNING: sqlite3 not found, appending grades to $SUMMARY without per test results"
+fi
+# every run has a directory of its own, so runs of the same homework at the
+# same time keep their events; those of runs that ended are removed
+for events in $PROGRESSDIR/$HWDIR/*/run.events;
+do
+    grep -qs "run_end" $events && rm -rf "$(dirname $events)"
+done
+rm -f $PROGRESSDIR/$HWDIR/*.events
+PROGRESSRUN="$PROGRESSDIR/$HWDIR/${RUNID//[^A-Za-z0-9._-]/_}-$$"
+mkdir -p $PROGRESSRUN
+if [[ $input ]];
+then
+    progress run_start "$RUNID" "$(grep -c "" "$input")"
+else
+    progress run_start "$RUNID" 1
+fi
 if [[ $input ]];
 then
     echo "Reading '${input}'"
@@ -154,6 +417,17 @@ else
     evaluate "unknown" "unknown" $login
 fi
 
+if [[ -x $OUTCOMEMATRIX ]];
+then
+    $OUTCOMEMATRIX build $RESULTS/$HWDIR
+fi
+if [[ $USEDB == 1 ]];
+then
+    write_summary
+    echo "Results of run '$RUNID' saved to $RESULTSDB, see results.sh"
+    [[ $TESTFLAGS ]] && echo "WARNING: run '$RUNID' was built with $TESTFLAGS, its grades are not in $SUMMARY"
+fi
+progress run_end
 echo "***** END EVALUATION *****"
 
 echo "Don't forget to run 'docker system prune' to remove extra containers"
@@ -0,0 +1,139 @@
+// Streaming CSV writer for the HW_5 read/write fixtures.
+
+#ifndef ECE590_CSV_WRITER_H
+#define ECE590_CSV_WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#define CSV_WRITER_BLOCK (1 << 16) // bytes buffered before each write to disk
+
+/*
+ * Writes a CSV file one cell at a time.
+ *
+ * Cells are formatted straight into a single reusable buffer that is flushed
+ * to disk in CSV_WRITER_BLOCK sized chunks, so writing a fixture costs no
+ * allocation per cell no matter how large the file gets. Doubles are written
+ * in the shortest form that reads back to exactly the same value.
+ *
+ * Rows are separated by newlines, with no newline after the last row, which
+ * matches the layout of the files the tests used to write from strings.
+ */
+class CsvWriter {
+public:
+
+    explicit CsvWriter(const std::string &path) : _row_started(false), _pending_newlines(0) {
+        _file = fopen(path.c_str(), "w");
+        _buffer.reserve(CSV_WRITER_BLOCK + 128);
+    }
+
+    ~CsvWriter() {
+        close();
+    }
+
+    /*!
+     * Write a double, optionally surrounded by whitespace padding
+     * @param x value to write
+     * @param whitespace padding character
+     * @param front number of padding characters before the value
+     * @param back number of padding characters after the value
+     * @return
+     */
+    CsvWriter& cell(double x, char whitespace = ' ', int front = 0, int back = 0) {
+        char digits[32];
+        int n = shortest(x, digits);
+        separate();
+        _buffer.append(front, whitespace);
+        _buffer.append(digits, n);
+        _buffer.append(back, whitespace);
+        return spill();
+    }
+
+    /*!
+     * Write a cell verbatim
+     * @param s
+     * @return
+     */
+    CsvWriter& cell(const char *s) {
+        separate();
+        _buffer.append(s);
+        return spill();
+    }
+
+    /*!
+     * End the current row. The newline is only written once the next
+     * row starts.
+     * @return
+     */
+    CsvWriter& end_row() {
+        _row_started = false;
+        _pending_newlines++;
+        return *this;
+    }
+
+    /*!
+     * Flush whatever is buffered and close the file
+     */
+    void close() {
+        if (_file) {
+            flush();
+            fclose(_file);
+            _file = NULL;
+        }
+    }
+
+    bool good() const {
+        return _file != NULL;
+    }
+
+    /*!
+     * Format a double with the fewest significant digits that still parse
+     * back to the same value.
+     * @param x
+     * @param out buffer of at least 32 characters
+     * @return number of characters written
+     */
+    static int shortest(double x, char *out) {
+        int n = 0;
+        for (int precision = 15; precision <= 17; precision++) {
+            n = snprintf(out, 32, "%.*g", precision, x);
+            if (strtod(out, NULL) == x) {
+                break;
+            }
+        }
+        return n;
+    }
+
+private:
+    FILE *_file;
+    std::string _buffer;
+    bool _row_started;
+    int _pending_newlines;
+
+    void separate() {
+        if (_row_started) {
+            _buffer.push_back(',');
+        } else {
+            _buffer.append(_pending_newlines, '\n');
+            _pending_newlines = 0;
+        }
+        _row_started = true;
+    }
+
+    CsvWriter& spill() {
+        if (_buffer.size() >= CSV_WRITER_BLOCK) {
+            flush();
+        }
+        return *this;
+    }
+
+    void flush() {
+        if (_file && !_buffer.empty()) {
+            fwrite(_buffer.data(), 1, _buffer.size(), _file);
+        }
+        _buffer.clear(); // keeps the capacity
+    }
+};
+
+#endif //ECE590_CSV_WRITER_H
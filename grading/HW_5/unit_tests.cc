@@ -10,6 +10,10 @@
 #include "typed_matrix.h"
 #include <fstream>
 #include "gtestnodeath.h"
+#include "csv_writer.h"
+#include "fuzz.h"
+#include "complexity.h"
+#include "alloc_stats.h"
 #include <vector>
 
 
@@ -25,6 +29,14 @@ using std::vector;
 #define Q4POINTS 100.0
 #define Q5POINTS 100.0
 #define NUM_QUESTIONS 5 // overestimated number of questions
+#ifndef FUZZ_SECONDS
+#define FUZZ_SECONDS 20 // time budget for each fuzzing campaign (make FUZZ=1)
+#endif
+#define FUZZ_REGRESSIONS "FuzzRegressions.txt"
+#define SORT_COMPLEXITY_MIN 4000 // smallest vector in SortComplexityTests, doubled 7 times (make TIMING=1)
+#define MAP_COMPLEXITY_MIN 2000  // fewest words in MapComplexityTests, doubled 6 times (make TIMING=1)
+#define ALLOC_MAP_WORDS 100000   // words in the text for MapAllocationTests (make ALLOC_STATS=1)
+#define ALLOC_MAP_PEAK_FACTOR 16 // peak heap allowed while mapping, as a multiple of the file size
 #define GTEST_COUT_GRADE std::cerr       << "[    GRADE ] "
 
 /*
@@ -350,13 +362,53 @@ protected:
        * @return
        */
       string save_csv(vector<vector<double>> &v) {
-          vector<vector<string>> s = to_vector_string(v);
-          return save_csv(s);
+          string default_path = "tmp.csv";
+          return save_csv(v, default_path);
+      }
+
+      /*!
+       * Stream a matrix of doubles to a csv without building strings.
+       *
+       * If "whitespace" is given, every value is padded with between 1 and 3
+       * of that character on each side. If "broken_row" is a valid row index,
+       * an extra "1.0" cell is added to the end of that row so the file no
+       * longer represents a matrix.
+       *
+       * @param v
+       * @param path
+       * @param whitespace padding character, or 0 for no padding
+       * @param broken_row row to add an extra cell to, or -1
+       * @return
+       */
+      string save_csv(const vector<vector<double>> &v, const string& path,
+                      char whitespace = 0, int broken_row = -1) {
+          CsvWriter out(path);
+          std::cout << "Saving file" << std::endl;
+          int rows = v.size();
+
+          for (int i = 0; i < rows; i++) {
+              for (int j = 0; j < v[i].size(); j++) {
+                  if (whitespace) {
+                      int front = random_int(1, 3), // add between 1 and 3 whitespace characters
+                          back = random_int(1, 3);
+                      out.cell(v[i][j], whitespace, front, back);
+                  } else {
+                      out.cell(v[i][j]);
+                  }
+              }
+              if (i == broken_row) {
+                  out.cell("1.0");
+              }
+              out.end_row();
+          }
+          out.close();
+          return path;
       }
 
     /*!
      * Create a random double csv of with "r" rows and "c" columns. With doubles
-     * inclusively between "mn" and "mx"
+     * inclusively between "mn" and "mx". Values are streamed straight to the
+     * file, so no matrix is built in memory.
      *
      * @param r num rows
      * @param c num cols
@@ -365,8 +417,16 @@ protected:
      * @return
      */
     string random_csv(int r, int c, int mn, int mx) {
-          vector<vector<double>> x = dbl_matrix(r, c, mn, mx);
-          return save_csv(x);
+          string path = "tmp.csv";
+          CsvWriter out(path);
+          for (int i = 0; i < r; i++) {
+              for (int j = 0; j < c; j++) {
+                  out.cell(random_dbl(mn, mx));
+              }
+              out.end_row();
+          }
+          out.close();
+          return path;
     }
 
     /*!
@@ -603,6 +663,22 @@ INSTANTIATE_TEST_CASE_P(SortTests,
         ::testing::Range(0, 1000, 100) // size of the first array
 );
 
+#ifdef GRADE_TIMING
+/*
+ * sort_by_magnitude should use std::sort, so its running time should grow
+ * as n log n. Timed, so not part of Question 1.
+ */
+class SortComplexityTests : public BaseTest {
+};
+
+TEST_F(SortComplexityTests, SortByMagIsNLogN) {
+    ASSERT_COMPLEXITY(LINEARITHMIC, size_ladder(SORT_COMPLEXITY_MIN, 7), [this](int n) {
+        vector<double> x = dbl_vector(n, -100.0, 100.0);
+        return elapsed_seconds([&x]() { sort_by_magnitude(x); });
+    });
+};
+#endif
+
 /*
  * Question 2 *************************************************
  * Rewrite the TypedMatrix class with vectors instead of TypedArrays.
@@ -895,6 +971,26 @@ INSTANTIATE_TEST_CASE_P(MatrixOperatorTests,
         )
 );
 
+#ifdef GRADE_ALLOC_STATS
+/*
+ * get should read the element in place, without copying the matrix or a row.
+ */
+class MatrixAllocationTests : public Question2 {
+};
+
+TEST_F(MatrixAllocationTests, GetDoesNotAllocate) {
+    TypedMatrix<double> m = dbl_typed_matrix(50, 50, -10.0, 10.0);
+    double sum = 0;
+    AllocScope scope;
+    for (int i = 0; i < 50; i++) {
+        for (int j = 0; j < 50; j++) {
+            sum += m.get(i, j);
+        }
+    }
+    ASSERT_EQ(scope.count(), 0) << "2500 calls to get allocated " << scope.bytes() << " bytes";
+}
+#endif
+
 /*
  * Question 3 *************************************************
  * Write a method in in utilities.h and utilities.cc
@@ -949,13 +1045,10 @@ TEST_P(ReadTests, ReadRandomBrokenCSV) {
 
     GTEST_COUT << "Rows: " << r << " Cols: " << c << std::endl;
     vector<vector<double>> x = dbl_matrix(r, c, -1000.0, 1000.0);
-    vector<vector<string>> s = to_vector_string(x);
 
     if (r > 0) {
         int i = random_int(0, r-1);
-        vector<string>& row = s[i];
-        row.push_back("1.0");
-        string path = save_csv(s, "tmp.csv");
+        string path = save_csv(x, "tmp.csv", 0, i);
 
         ASSERT_NO_DEATH(read_matrix_csv(path), ".*"); // should not crash, but throw error
         if (r > 1) {
@@ -978,18 +1071,8 @@ TEST_P(ReadTestsWhiteSpace, ReadRandomCSVWithSpaces) {
     char whitespace = std::get<2>(params);
     GTEST_COUT << "Rows: " << r << " Cols: " << c << std::endl;
     vector<vector<double>> x = dbl_matrix(r, c, -1000.0, 1000.0);
-    vector<vector<string>> s = to_vector_string(x);
-    string fpad, bpad;
 
-    for (int i = 0; i < r; i++) {
-        for (int j = 0; j < c; j++) {
-            fpad.assign(random_int(1, 3), whitespace); // add between 1 and 3 whitespace characters
-            bpad.assign(random_int(1, 3), whitespace);
-            s[i][j] = fpad + s[i][j] + bpad;
-        }
-    }
-
-    string path = save_csv(s, "tmp.csv");
+    string path = save_csv(x, "tmp.csv", whitespace);
 }
 
 INSTANTIATE_TEST_CASE_P(ReadTests,
@@ -1007,6 +1090,56 @@ INSTANTIATE_TEST_CASE_P(ReadTestsWhiteSpace, ReadTestsWhiteSpace,
                 testing::Values(' ', '\t')  // white space character
                 ));
 
+/*
+ * Inputs that used to break read_matrix_csv. These are the hand-written broken
+ * files plus any crashers promoted from fuzzing campaigns (see FuzzCrashes.txt
+ * after running with make FUZZ=1). Throwing is fine, crashing is not.
+ */
+class ReadRegressionTests : public Question3,
+                  public ::testing::WithParamInterface<string> {
+};
+
+TEST_P(ReadRegressionTests, NoCrashOnBrokenCSV) {
+    string path = "regression.csv";
+    fuzz_write_file(path, GetParam());
+    GTEST_COUT << "Input: " << fuzz_escape(GetParam()) << std::endl;
+
+    ASSERT_NO_DEATH({
+        try {
+            read_matrix_csv(path);
+        } catch (...) {}
+    }, ".*");
+}
+
+INSTANTIATE_TEST_CASE_P(ReadRegressionTests, ReadRegressionTests,
+        ::testing::ValuesIn(fuzz_load_regressions(FUZZ_REGRESSIONS, "read_matrix_csv"))
+);
+
+#ifdef GRADE_FUZZ
+class ReadFuzzTests : public Question3 {
+};
+
+/*
+ * Drives read_matrix_csv in-process for FUZZ_SECONDS, starting from small
+ * valid and broken files. Every crashing input found is reported.
+ */
+TEST_F(ReadFuzzTests, FuzzReadMatrixCSV) {
+    Fuzzer fuzzer("read_matrix_csv", [](const string &input, const string &path) -> uint64_t {
+        TypedMatrix<double> m = read_matrix_csv(path);
+        return 1;
+    });
+    fuzzer.seed("1.0,2.0\n3.0,4.0")
+          .seed(" 1.5 ,\t-2.25\t\n3e2,  4 ")
+          .seed("1.0,2.0,3.0\n4.0,5.0")
+          .dictionary({",", "\n", " ", "\t", "-", ".", "e", "e-", "1e308", "nan", "inf", "0", "9"});
+
+    vector<FuzzCrash> crashes = fuzzer.run(FUZZ_SECONDS);
+    for (const FuzzCrash &c : crashes) {
+        ADD_FAILURE() << "read_matrix_csv crashed on \"" << fuzz_escape(c.input) << "\"";
+    }
+}
+#endif
+
 /*
  * Question 4 *************************************************
  * Write a method
@@ -1138,4 +1271,103 @@ TEST_P(MapKeywordTests, CheckNumInstanceCorrect) {
 
 INSTANTIATE_TEST_CASE_P(MapKeywordTests, MapKeywordTests,
         ::testing::ValuesIn(expected_map_) // size of the first array
-);
\ No newline at end of file
+);
+
+/*
+ * Inputs that used to break occurrence_map, as for ReadRegressionTests.
+ */
+class MapRegressionTests : public Question5,
+                  public ::testing::WithParamInterface<string> {
+};
+
+TEST_P(MapRegressionTests, NoCrashOnOddText) {
+    string path = "regression.txt";
+    fuzz_write_file(path, GetParam());
+    GTEST_COUT << "Input: " << fuzz_escape(GetParam()) << std::endl;
+
+    ASSERT_NO_DEATH({
+        try {
+            occurrence_map(path);
+        } catch (...) {}
+    }, ".*");
+}
+
+INSTANTIATE_TEST_CASE_P(MapRegressionTests, MapRegressionTests,
+        ::testing::ValuesIn(fuzz_load_regressions(FUZZ_REGRESSIONS, "occurrence_map"))
+);
+
+#ifdef GRADE_TIMING
+/*
+ * occurrence_map should take time linear in the length of the text. The
+ * text reuses a fixed vocabulary, so the map itself stays the same size.
+ * Timed, so not part of Question 5.
+ */
+class MapComplexityTests : public BaseTest {
+};
+
+TEST_F(MapComplexityTests, OccurrenceMapIsLinear) {
+    string path = "complexity.txt";
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(MAP_COMPLEXITY_MIN, 6), [this, &path](int n) {
+        std::ofstream text(path);
+        for (int i = 0; i < n; i++) {
+            int w = random_int(0, 500);
+            text << (w % 7 ? "word" : "Don't") << w << (i % 12 == 11 ? ".\n" : " ");
+        }
+        text.close();
+        return elapsed_seconds([&path]() { occurrence_map(path); });
+    });
+}
+#endif
+
+#ifdef GRADE_ALLOC_STATS
+/*
+ * occurrence_map may hold the text and its words, but should not keep many
+ * copies of the file alive at once.
+ */
+class MapAllocationTests : public Question5 {
+};
+
+TEST_F(MapAllocationTests, PeakMemoryIsBounded) {
+    string path = "allocations.txt";
+    std::ofstream text(path);
+    for (int i = 0; i < ALLOC_MAP_WORDS; i++) {
+        int w = random_int(0, 500);
+        text << (w % 7 ? "word" : "Don't") << w << (i % 12 == 11 ? ".\n" : " ");
+    }
+    long size = text.tellp();
+    text.close();
+
+    AllocScope scope;
+    occurrence_map(path);
+    GTEST_COUT << "File of " << size << " bytes, peak heap " << scope.peak() << " bytes" << std::endl;
+    ASSERT_LE(scope.peak(), ALLOC_MAP_PEAK_FACTOR * size);
+}
+#endif
+
+#ifdef GRADE_FUZZ
+class MapFuzzTests : public Question5 {
+};
+
+/*
+ * Drives occurrence_map in-process for FUZZ_SECONDS, starting from the
+ * lorem ipsum text. Every crashing input found is reported.
+ */
+TEST_F(MapFuzzTests, FuzzOccurrenceMap) {
+    Fuzzer fuzzer("occurrence_map", [](const string &input, const string &path) -> uint64_t {
+        std::map<string, int> m = occurrence_map(path);
+        return 1 + std::min<size_t>(m.size(), 16);
+    });
+    std::ifstream text(txt_path_);
+    string line;
+    for (int i = 0; i < 4 && std::getline(text, line); i++) {
+        fuzzer.seed(line);
+    }
+    fuzzer.seed("I'm so \"done\"!")
+          .dictionary({"'", "\"", " ", "\n", "\t", "-", "_", "$", "%", "A", "z", "0", "\xc3\xa9", "\xff"});
+
+    vector<FuzzCrash> crashes = fuzzer.run(FUZZ_SECONDS);
+    for (const FuzzCrash &c : crashes) {
+        ADD_FAILURE() << "occurrence_map crashed on \"" << fuzz_escape(c.input) << "\"";
+    }
+}
+#endif
@@ -0,0 +1,175 @@
+// Heap allocation statistics per test.
+
+#ifndef ECE590_ALLOC_STATS_H
+#define ECE590_ALLOC_STATS_H
+
+#include <stddef.h>
+#include <atomic>
+
+/*
+ * Built with "make ALLOC_STATS=1" (GRADE_ALLOC_STATS), the test binary counts
+ * every heap allocation: malloc, calloc, realloc, and operator new, which
+ * ends up in malloc. The listener in main.cc prints one line per test,
+ *
+ *     ALLOCATIONS: count=12 bytes=4096 peak=2048
+ *
+ * and tests can measure a block of code with an AllocScope:
+ *
+ *     AllocScope scope;
+ *     m.get(0, 0);
+ *     ASSERT_EQ(scope.count(), 0);
+ *
+ * Under AddressSanitizer, which owns malloc, the counts come from its
+ * allocator hooks. Otherwise malloc and friends are replaced and forwarded
+ * to glibc. Either way the hooks are defined once, in main.cc, which
+ * defines ALLOC_STATS_IMPLEMENTATION before including this header.
+ *
+ * Without GRADE_ALLOC_STATS nothing is counted and alloc_stats_enabled()
+ * is false, so tests built on it are left out, as the fuzz tests are.
+ */
+struct AllocCounters {
+    std::atomic<long> count;  // allocations so far
+    std::atomic<long> bytes;  // bytes allocated so far
+    std::atomic<long> live;   // bytes currently allocated
+    std::atomic<long> peak;   // highest value of live since the last reset
+};
+
+inline AllocCounters &alloc_counters() {
+    static AllocCounters counters;
+    return counters;
+}
+
+inline bool alloc_stats_enabled() {
+#ifdef GRADE_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline void alloc_stats_record_malloc(size_t size) {
+    AllocCounters &c = alloc_counters();
+    c.count++;
+    c.bytes += size;
+    long live = (c.live += size);
+    long peak = c.peak;
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live)) {
+    }
+}
+
+inline void alloc_stats_record_free(size_t size) {
+    alloc_counters().live -= size;
+}
+
+/*
+ * Allocations made while the scope is alive. The peak is measured above the
+ * heap size when the scope started.
+ */
+class AllocScope {
+public:
+    AllocScope() {
+        AllocCounters &c = alloc_counters();
+        _count = c.count;
+        _bytes = c.bytes;
+        _live = c.live;
+        _outer_peak = c.peak.exchange(_live);
+    }
+
+    ~AllocScope() {
+        AllocCounters &c = alloc_counters();
+        long peak = c.peak;
+        while (_outer_peak > peak && !c.peak.compare_exchange_weak(peak, _outer_peak)) {
+        }
+    }
+
+    long count() const {
+        return alloc_counters().count - _count;
+    }
+
+    long bytes() const {
+        return alloc_counters().bytes - _bytes;
+    }
+
+    long peak() const {
+        return alloc_counters().peak - _live;
+    }
+
+private:
+    long _count, _bytes, _live, _outer_peak;
+};
+
+#if defined(GRADE_ALLOC_STATS) && defined(ALLOC_STATS_IMPLEMENTATION)
+
+#if defined(__SANITIZE_ADDRESS__)
+
+// from <sanitizer/allocator_interface.h>, which not every toolchain ships
+extern "C" {
+int __sanitizer_install_malloc_and_free_hooks(void (*malloc_hook)(const volatile void *, size_t),
+                                              void (*free_hook)(const volatile void *));
+size_t __sanitizer_get_allocated_size(const volatile void *p);
+}
+
+extern "C" void alloc_stats_malloc_hook(const volatile void *ptr, size_t size) {
+    alloc_stats_record_malloc(size);
+}
+
+extern "C" void alloc_stats_free_hook(const volatile void *ptr) {
+    if (ptr) {
+        alloc_stats_record_free(__sanitizer_get_allocated_size(ptr));
+    }
+}
+
+static int alloc_stats_hooks_installed =
+        __sanitizer_install_malloc_and_free_hooks(alloc_stats_malloc_hook, alloc_stats_free_hook);
+
+#else
+
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    if (p) {
+        alloc_stats_record_malloc(malloc_usable_size(p));
+    }
+    return p;
+}
+
+void *calloc(size_t n, size_t size) {
+    void *p = __libc_calloc(n, size);
+    if (p) {
+        alloc_stats_record_malloc(malloc_usable_size(p));
+    }
+    return p;
+}
+
+void *realloc(void *ptr, size_t size) {
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void *p = __libc_realloc(ptr, size);
+    if (p || size == 0) {
+        alloc_stats_record_free(old);
+    }
+    if (p) {
+        alloc_stats_record_malloc(malloc_usable_size(p));
+    }
+    return p;
+}
+
+void free(void *ptr) {
+    if (ptr) {
+        alloc_stats_record_free(malloc_usable_size(ptr));
+    }
+    __libc_free(ptr);
+}
+}
+
+#endif
+
+#endif
+
+#endif //ECE590_ALLOC_STATS_H
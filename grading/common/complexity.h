@@ -0,0 +1,187 @@
+// Asymptotic complexity checks.
+
+#ifndef ECE590_COMPLEXITY_H
+#define ECE590_COMPLEXITY_H
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+#define COMPLEXITY_REPEATS 5      // runs per size, the cheapest one is kept
+#define COMPLEXITY_TOLERANCE 0.35 // allowed growth exponent above the declared class
+#define COMPLEXITY_BUDGET 10.0    // seconds; past this, no more repeats and no larger sizes (after 3)
+
+/*
+ * A test declares the complexity class of a student function and gives a
+ * cost for running it at size n, either a time or a count of operations:
+ *
+ *     ASSERT_COMPLEXITY(LINEARITHMIC, size_ladder(1000, 6), [](int n) {
+ *         vector<double> x = ...;
+ *         return elapsed_seconds([&]() { sort_by_magnitude(x); });
+ *     });
+ *
+ * Each size is run COMPLEXITY_REPEATS times and the cheapest run is kept,
+ * which drops the runs that were slowed down by the rest of the machine.
+ * The costs are divided by the declared model (n, n log n, ...) and the
+ * growth exponent of what remains is fitted on a log-log scale, using the
+ * median of the slopes between every two sizes so one bad point cannot
+ * swing the fit. Anything that grows as the declared class leaves an
+ * exponent close to 0; an extra factor of n leaves about 1. The check fails
+ * above COMPLEXITY_TOLERANCE. A slow implementation stops climbing the
+ * ladder once COMPLEXITY_BUDGET is spent, so it fails without stalling the
+ * grading run. Timed checks depend on the load of the machine; keep them out
+ * of the Question fixtures and behind GRADE_TIMING (make TIMING=1).
+ */
+enum ComplexityClass {
+    CONSTANT,
+    LOGARITHMIC,
+    LINEAR,
+    LINEARITHMIC,
+    QUADRATIC
+};
+
+inline const char *complexity_name(ComplexityClass c) {
+    switch (c) {
+        case CONSTANT:
+            return "O(1)";
+        case LOGARITHMIC:
+            return "O(log n)";
+        case LINEAR:
+            return "O(n)";
+        case LINEARITHMIC:
+            return "O(n log n)";
+        default:
+            return "O(n^2)";
+    }
+}
+
+/*!
+ * Expected cost of a complexity class at size n, up to a constant
+ */
+inline double complexity_model(ComplexityClass c, double n) {
+    switch (c) {
+        case CONSTANT:
+            return 1;
+        case LOGARITHMIC:
+            return log2(n + 1);
+        case LINEAR:
+            return n;
+        case LINEARITHMIC:
+            return n * log2(n + 1);
+        default:
+            return n * n;
+    }
+}
+
+/*!
+ * Geometric sizes min, min*factor, ... (steps of them)
+ */
+inline std::vector<int> size_ladder(int min, int steps, double factor = 2.0) {
+    std::vector<int> sizes;
+    double n = min;
+    for (int i = 0; i < steps; i++, n *= factor) {
+        sizes.push_back((int) n);
+    }
+    return sizes;
+}
+
+/*!
+ * Wall time of a single call, in seconds
+ */
+template<typename F>
+double elapsed_seconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*!
+ * Median of the slopes between every two points (Theil-Sen)
+ */
+inline double median_slope(const std::vector<double> &x, const std::vector<double> &y) {
+    std::vector<double> slopes;
+    for (size_t i = 0; i < x.size(); i++) {
+        for (size_t j = i + 1; j < x.size(); j++) {
+            if (x[j] != x[i]) {
+                slopes.push_back((y[j] - y[i]) / (x[j] - x[i]));
+            }
+        }
+    }
+    if (slopes.empty()) {
+        return 0;
+    }
+    std::sort(slopes.begin(), slopes.end());
+    size_t m = slopes.size() / 2;
+    return slopes.size() % 2 ? slopes[m] : (slopes[m - 1] + slopes[m]) / 2;
+}
+
+struct ComplexityResult {
+    ComplexityClass declared;
+    std::vector<int> sizes;
+    std::vector<double> costs;
+    double exponent;  // fitted growth of cost / model
+    bool passed;
+
+    std::string report() const {
+        std::ostringstream os;
+        for (size_t i = 0; i < sizes.size(); i++) {
+            os << "n=" << sizes[i] << " cost=" << costs[i] << std::endl;
+        }
+        os << "Growth beyond " << complexity_name(declared) << ": n^" << exponent
+           << (passed ? "" : " (too fast)");
+        return os.str();
+    }
+};
+
+/*!
+ * Run cost(n) over the sizes and fit it against the declared class
+ * @param declared
+ * @param sizes
+ * @param cost cost of one run at size n; time or counted operations
+ * @param repeats runs per size, the minimum is kept
+ * @param tolerance growth exponent allowed above the declared class
+ * @return
+ */
+inline ComplexityResult measure_complexity(ComplexityClass declared, const std::vector<int> &sizes,
+                                           std::function<double(int)> cost, int repeats = COMPLEXITY_REPEATS,
+                                           double tolerance = COMPLEXITY_TOLERANCE) {
+    ComplexityResult result;
+    result.declared = declared;
+    std::vector<double> log_n, log_excess;
+    auto start = std::chrono::steady_clock::now();
+    auto spent = [&start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    for (int n : sizes) {
+        if (result.sizes.size() >= 3 && spent() > COMPLEXITY_BUDGET) {
+            break;
+        }
+        double best = cost(n);
+        for (int r = 1; r < repeats && spent() <= COMPLEXITY_BUDGET; r++) {
+            best = std::min(best, cost(n));
+        }
+        result.sizes.push_back(n);
+        result.costs.push_back(best);
+        log_n.push_back(log(n));
+        log_excess.push_back(log(std::max(best, 1e-12) / complexity_model(declared, n)));
+    }
+    result.exponent = median_slope(log_n, log_excess);
+    result.passed = result.exponent <= tolerance;
+    return result;
+}
+
+// variadic so the cost lambda may contain commas
+#define ASSERT_COMPLEXITY(declared, sizes, ...) { \
+    ComplexityResult _complexity_result = measure_complexity(declared, sizes, __VA_ARGS__); \
+    if (!_complexity_result.passed) { \
+        FAIL() << "Expected " << complexity_name(declared) << std::endl << _complexity_result.report(); \
+    } \
+    std::cout << _complexity_result.report() << std::endl; \
+}
+
+#endif //ECE590_COMPLEXITY_H
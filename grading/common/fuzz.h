@@ -0,0 +1,459 @@
+// In-process fuzzing of student functions.
+
+#ifndef ECE590_FUZZ_H
+#define ECE590_FUZZ_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define FUZZ_MAP_SIZE (1 << 16)     // number of coverage counters
+#define FUZZ_MAX_INPUT 4096         // largest input the mutator will build
+#define FUZZ_MAX_CRASHES 8          // stop the campaign after this many crashes
+#define FUZZ_MAX_REGRESSIONS 3      // fastest crashers kept as regression cases
+#define FUZZ_MINIMIZE_RUNS 256      // executions spent minimizing each crasher
+#define FUZZ_HANG_SECONDS 2.0       // a single input running longer than this is a hang
+#define FUZZ_DELIM " %%:%% "        // separates target name and input in regression files
+#define FUZZ_CRASH_FILE "FuzzCrashes.txt"
+
+/*
+ * Coverage counters. When the student sources are compiled with
+ * -fsanitize-coverage=trace-pc (make FUZZ=1), every basic block calls
+ * __sanitizer_cov_trace_pc, which bumps the counter for the edge just taken.
+ * Without instrumentation the map only sees the behaviour signature returned
+ * by the target, so the fuzzer degrades to a plain mutation fuzzer.
+ */
+inline uint8_t *fuzz_coverage() {
+    static uint8_t map[FUZZ_MAP_SIZE];
+    return map;
+}
+
+inline uintptr_t &fuzz_previous_location() {
+    static uintptr_t previous;
+    return previous;
+}
+
+extern "C" __attribute__((weak)) void __sanitizer_cov_trace_pc() {
+    uintptr_t pc = (uintptr_t) __builtin_return_address(0);
+    uintptr_t location = (pc ^ (pc >> 16)) & (FUZZ_MAP_SIZE - 1);
+    fuzz_coverage()[location ^ fuzz_previous_location()]++;
+    fuzz_previous_location() = location >> 1;
+}
+
+/*!
+ * Escape an input so it fits on one line of a regression file
+ * @param s
+ * @return
+ */
+inline std::string fuzz_escape(const std::string &s) {
+    static const char *hex = "0123456789abcdef";
+    std::string out;
+    for (unsigned char c : s) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c < 0x20 || c >= 0x7f) {
+            out += "\\x";
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+        } else {
+            out += (char) c;
+        }
+    }
+    return out;
+}
+
+/*!
+ * Undo fuzz_escape
+ * @param s
+ * @return
+ */
+inline std::string fuzz_unescape(const std::string &s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] != '\\' || i + 1 == s.size()) {
+            out += s[i];
+            continue;
+        }
+        char c = s[++i];
+        if (c == 'n') {
+            out += '\n';
+        } else if (c == 't') {
+            out += '\t';
+        } else if (c == 'r') {
+            out += '\r';
+        } else if (c == 'x' && i + 2 < s.size()) {
+            out += (char) std::stoi(s.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+/*!
+ * Load the regression inputs for one target. Each line of the file is
+ * "<target> %%:%% <escaped input>". The space after the delimiter is
+ * optional, so an empty input survives editors that strip trailing spaces.
+ * @param path
+ * @param target
+ * @return
+ */
+inline std::vector<std::string> fuzz_load_regressions(const std::string &path, const std::string &target) {
+    std::ifstream infile(path);
+    std::vector<std::string> inputs;
+    std::string line, delim = FUZZ_DELIM;
+    delim.pop_back(); // trailing space
+    while (std::getline(infile, line)) {
+        size_t n = line.find(delim);
+        if (n != std::string::npos && line.substr(0, n) == target) {
+            size_t start = n + delim.size();
+            if (start < line.size() && line[start] == ' ') {
+                start++;
+            }
+            inputs.push_back(fuzz_unescape(line.substr(start)));
+        }
+    }
+    return inputs;
+}
+
+/*!
+ * Write an input to a file, exactly as given
+ * @param path
+ * @param input
+ */
+inline void fuzz_write_file(const std::string &path, const std::string &input) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f) {
+        fwrite(input.data(), 1, input.size(), f);
+        fclose(f);
+    }
+}
+
+/*
+ * A crashing input found by a campaign, after minimization.
+ */
+struct FuzzCrash {
+    std::string input;
+    double seconds; // time for one execution of the minimized input
+    int status;     // wait status of the crashed process
+};
+
+/*
+ * Coverage-guided fuzzer for a single student function.
+ *
+ * The target gets each input both as a string and as the path of a file
+ * holding it, so parsers that take a path need no extra I/O. It returns a
+ * small behaviour signature (e.g. "threw" vs "returned"), which is folded
+ * into the coverage map. Exceptions escaping the target are not crashes.
+ *
+ * The campaign runs in one forked child that executes inputs back to back
+ * in-process until the time budget is spent. The input being executed is
+ * always on disk, so when the child dies the supervisor knows which input
+ * killed it. That input is minimized, timed and recorded, and the campaign
+ * resumes from its saved corpus with whatever budget is left.
+ */
+class Fuzzer {
+public:
+    typedef std::function<uint64_t(const std::string &input, const std::string &path)> Target;
+
+    Fuzzer(const std::string &name, Target target) : _name(name), _target(target), _rng(0x5eed) {
+        _input_path = name + ".fuzz_input";
+        _corpus_path = name + ".fuzz_corpus";
+        remove(_corpus_path.c_str());
+    }
+
+    Fuzzer &seed(const std::string &input) {
+        _seeds.push_back(input);
+        return *this;
+    }
+
+    Fuzzer &dictionary(const std::vector<std::string> &tokens) {
+        _dictionary.insert(_dictionary.end(), tokens.begin(), tokens.end());
+        return *this;
+    }
+
+    const std::string &input_path() const {
+        return _input_path;
+    }
+
+    /*!
+     * Fuzz for the given number of seconds
+     * @param seconds
+     * @return crashes found, fastest first
+     */
+    std::vector<FuzzCrash> run(double seconds) {
+        std::vector<FuzzCrash> crashes;
+        Clock::time_point deadline = Clock::now() + to_duration(seconds);
+        int duplicates = 0;
+
+        while (Clock::now() < deadline && crashes.size() < FUZZ_MAX_CRASHES) {
+            std::cout.flush();
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                campaign(deadline);
+                std::cout.flush();
+                _exit(0);
+            }
+            int status = supervise(pid, deadline + to_duration(FUZZ_HANG_SECONDS));
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                break;
+            }
+
+            FuzzCrash crash;
+            crash.input = minimize(read_file(_input_path));
+            crash.status = execute(crash.input, &crash.seconds);
+            bool known = false;
+            for (const FuzzCrash &c : crashes) {
+                known = known || c.input == crash.input;
+            }
+            if (!known) {
+                crashes.push_back(crash);
+            } else if (++duplicates >= 2) {
+                break; // the same bug keeps killing the campaign
+            }
+            // never rediscover the same crasher
+            std::ofstream corpus(_corpus_path, std::ios::app);
+            corpus << "!" << fuzz_escape(crash.input) << "\n";
+        }
+
+        std::sort(crashes.begin(), crashes.end(), [](const FuzzCrash &a, const FuzzCrash &b) {
+            return a.seconds < b.seconds;
+        });
+        save_regressions(crashes);
+        return crashes;
+    }
+
+    /*!
+     * Run one input in a separate process
+     * @param input
+     * @param seconds time taken
+     * @return wait status, 0 if the target returned normally
+     */
+    int execute(const std::string &input, double *seconds = nullptr) {
+        Clock::time_point start = Clock::now();
+        std::cout.flush();
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            int devnull = open("/dev/null", O_WRONLY); // keep sanitizer reports out of the log
+            dup2(devnull, 1);
+            dup2(devnull, 2);
+            fuzz_write_file(_input_path, input);
+            call(input);
+            _exit(0);
+        }
+        int status = supervise(pid, start + to_duration(FUZZ_HANG_SECONDS));
+        if (seconds) {
+            *seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        return status;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::string _name, _input_path, _corpus_path;
+    Target _target;
+    std::mt19937 _rng;
+    std::vector<std::string> _seeds, _dictionary, _corpus;
+    std::vector<std::string> _known_crashes;
+    uint8_t _virgin[FUZZ_MAP_SIZE];
+
+    static Clock::duration to_duration(double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    uint64_t call(const std::string &input) {
+        try {
+            return _target(input, _input_path);
+        } catch (...) {
+            return 0xe;
+        }
+    }
+
+    static std::string read_file(const std::string &path) {
+        std::ifstream infile(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    }
+
+    /*!
+     * Wait for a child, killing it once the deadline has passed
+     * @return wait status
+     */
+    static int supervise(pid_t pid, Clock::time_point deadline) {
+        int status = 0;
+        while (waitpid(pid, &status, WNOHANG) == 0) {
+            if (Clock::now() > deadline) {
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                break;
+            }
+            usleep(1000);
+        }
+        return status;
+    }
+
+    /*!
+     * Classify the coverage of the last execution, AFL style, and record
+     * any bucket not seen before.
+     * @return true if the input reached something new
+     */
+    bool novel(uint64_t signature) {
+        uint8_t *map = fuzz_coverage();
+        map[(signature * 0x9e3779b97f4a7c15ULL) >> 48]++;
+        bool found = false;
+        for (int i = 0; i < FUZZ_MAP_SIZE; i++) {
+            if (map[i]) {
+                uint8_t c = map[i];
+                uint8_t bucket = c < 4 ? c : c < 8 ? 8 : c < 16 ? 16 : c < 32 ? 32 : c < 128 ? 64 : 128;
+                if (bucket & ~_virgin[i]) {
+                    _virgin[i] |= bucket;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    std::string mutate(std::string s) {
+        int rounds = 1 + _rng() % 4;
+        for (int r = 0; r < rounds; r++) {
+            size_t n = s.size();
+            switch (_rng() % 7) {
+                case 0: // flip a bit
+                    if (n) s[_rng() % n] ^= (char) (1 << (_rng() % 8));
+                    break;
+                case 1: // random byte
+                    if (n) s[_rng() % n] = (char) _rng();
+                    break;
+                case 2: // insert a random byte
+                    s.insert(s.begin() + (n ? _rng() % (n + 1) : 0), (char) _rng());
+                    break;
+                case 3: // delete a range
+                    if (n) {
+                        size_t at = _rng() % n;
+                        s.erase(at, 1 + _rng() % std::min<size_t>(n - at, 16));
+                    }
+                    break;
+                case 4: // duplicate a range
+                    if (n) {
+                        size_t at = _rng() % n, len = 1 + _rng() % std::min<size_t>(n - at, 64);
+                        s.insert(_rng() % (n + 1), s.substr(at, len));
+                    }
+                    break;
+                case 5: // insert a dictionary token
+                    if (!_dictionary.empty()) {
+                        s.insert(_rng() % (n + 1), _dictionary[_rng() % _dictionary.size()]);
+                    }
+                    break;
+                default: // splice with another corpus entry
+                    if (!_corpus.empty()) {
+                        const std::string &other = _corpus[_rng() % _corpus.size()];
+                        s = s.substr(0, n ? _rng() % (n + 1) : 0) + other.substr(other.empty() ? 0 : _rng() % other.size());
+                    }
+                    break;
+            }
+        }
+        if (s.size() > FUZZ_MAX_INPUT) {
+            s.resize(FUZZ_MAX_INPUT);
+        }
+        return s;
+    }
+
+    /*!
+     * The child side of a campaign: execute mutated inputs until the
+     * deadline, growing the corpus with inputs that find new coverage.
+     */
+    void campaign(Clock::time_point deadline) {
+        memset(_virgin, 0, sizeof(_virgin));
+        _corpus = _seeds;
+        if (_corpus.empty()) {
+            _corpus.push_back("");
+        }
+        std::ifstream saved(_corpus_path);
+        std::string line;
+        while (std::getline(saved, line)) {
+            if (!line.empty() && line[0] == '!') {
+                _known_crashes.push_back(fuzz_unescape(line.substr(1)));
+            } else {
+                _corpus.push_back(fuzz_unescape(line));
+            }
+        }
+        _rng.seed(0x5eed + _corpus.size() + _known_crashes.size());
+        std::ofstream corpus(_corpus_path, std::ios::app);
+
+        long executions = 0;
+        size_t start_size = _corpus.size();
+        for (long i = 0; (i & 63) || Clock::now() < deadline; i++) {
+            // replay the corpus once, then mutate
+            std::string input = i < (long) start_size ? _corpus[i] : mutate(_corpus[_rng() % _corpus.size()]);
+            if (std::find(_known_crashes.begin(), _known_crashes.end(), input) != _known_crashes.end()) {
+                continue;
+            }
+            memset(fuzz_coverage(), 0, FUZZ_MAP_SIZE);
+            fuzz_previous_location() = 0;
+            fuzz_write_file(_input_path, input);
+            uint64_t signature = call(input);
+            executions++;
+            if (novel(signature)) {
+                _corpus.push_back(input);
+                corpus << fuzz_escape(input) << "\n";
+                corpus.flush();
+            }
+        }
+        std::cout << "[    INFO  ] fuzz " << _name << ": " << executions << " executions, "
+                  << _corpus.size() - start_size << " new corpus entries" << std::endl;
+    }
+
+    /*!
+     * Shrink a crashing input by deleting chunks, halving the chunk size
+     * whenever no deletion of the current size still crashes.
+     */
+    std::string minimize(std::string input) {
+        int runs = 0;
+        for (size_t chunk = std::max<size_t>(input.size() / 2, 1); chunk > 0 && runs < FUZZ_MINIMIZE_RUNS; chunk /= 2) {
+            for (size_t at = 0; at < input.size() && runs < FUZZ_MINIMIZE_RUNS; runs++) {
+                std::string candidate = input.substr(0, at) + input.substr(std::min(at + chunk, input.size()));
+                if (execute(candidate) != 0) {
+                    input = candidate;
+                } else {
+                    at += chunk;
+                }
+            }
+        }
+        return input;
+    }
+
+    /*!
+     * Append the fastest crashers to the crash file in regression format,
+     * ready to be promoted to the homework's FuzzRegressions.txt.
+     */
+    void save_regressions(const std::vector<FuzzCrash> &crashes) {
+        std::ofstream out(FUZZ_CRASH_FILE, std::ios::app);
+        for (size_t i = 0; i < crashes.size() && i < FUZZ_MAX_REGRESSIONS; i++) {
+            out << _name << FUZZ_DELIM << fuzz_escape(crashes[i].input) << "\n";
+        }
+    }
+};
+
+#endif //ECE590_FUZZ_H
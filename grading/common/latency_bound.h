@@ -0,0 +1,261 @@
+// Overlapping latency-bound tests.
+
+#ifndef ECE590_LATENCY_BOUND_H
+#define ECE590_LATENCY_BOUND_H
+
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+extern char **environ;
+
+#define LATENCY_JOBS 8                          // default number of latency-bound tests run at once
+#define LATENCY_JOBS_FLAG "--latency_jobs="     // command line flag to change it, 0 runs them in-process
+#define LATENCY_CHILD_SECONDS 120               // a latency-bound test still running after this long is killed
+#define LATENCY_CHILD_ENV "GRADE_LATENCY_CHILD" // set in the processes running a single latency-bound test
+#define LATENCY_GRADE_PATTERN "HOMEWORK_GRADE: "
+
+/*
+ * Tests that spend their time sleeping or waiting on a real clock are
+ * "latency-bound": they barely use a core, so running them one after another
+ * only wastes wall time. A homework tags them with
+ *
+ *     LATENCY_BOUND_TESTS("StopwatchRealTimeTests.*:OtherSuite.SomeTest");
+ *
+ * using gtest filter syntax. main() then runs each tagged test in its own
+ * process, up to LATENCY_JOBS at a time, before the CPU-bound tests run as
+ * usual in the main process. The tagged tests overlap with each other but
+ * not with the rest of the suite, so neither disturbs the timings of the
+ * other. A child still running after LATENCY_CHILD_SECONDS is killed and
+ * its test fails. The output of each child is appended to the main output
+ * and its results are added to the homework grade.
+ */
+inline std::vector<std::string> &latency_bound_patterns() {
+    static std::vector<std::string> patterns;
+    return patterns;
+}
+
+struct LatencyBoundTag {
+    explicit LatencyBoundTag(const std::string &filter) {
+        size_t start = 0, end;
+        do {
+            end = filter.find(':', start);
+            latency_bound_patterns().push_back(filter.substr(start, end - start));
+            start = end + 1;
+        } while (end != std::string::npos);
+    }
+};
+
+#define LATENCY_BOUND_TESTS(filter) \
+    static LatencyBoundTag GTEST_CONCAT_TOKEN_(latency_bound_tag_, __LINE__)(filter)
+
+/*!
+ * Glob match with '*' and '?', as in gtest filters
+ */
+inline bool latency_glob(const char *pattern, const char *name) {
+    if (*pattern == '\0') {
+        return *name == '\0';
+    }
+    if (*pattern == '*') {
+        return latency_glob(pattern + 1, name) || (*name && latency_glob(pattern, name + 1));
+    }
+    return *name && (*pattern == '?' || *pattern == *name) && latency_glob(pattern + 1, name + 1);
+}
+
+/*!
+ * Whether a test name matches a full gtest filter, "POSITIVE[-NEGATIVE]"
+ */
+inline bool latency_matches_filter(const std::string &name, const std::string &filter) {
+    size_t dash = filter.find('-');
+    std::string positive = filter.substr(0, dash);
+    std::string negative = dash == std::string::npos ? "" : filter.substr(dash + 1);
+    auto any = [&name](const std::string &patterns) {
+        size_t start = 0, end;
+        do {
+            end = patterns.find(':', start);
+            if (latency_glob(patterns.substr(start, end - start).c_str(), name.c_str())) {
+                return true;
+            }
+            start = end + 1;
+        } while (end != std::string::npos);
+        return false;
+    };
+    return (positive.empty() || any(positive)) && !any(negative);
+}
+
+/*
+ * Runs the tagged tests in child processes before the main test run.
+ */
+class LatencyBoundRunner {
+public:
+
+    LatencyBoundRunner(int argc, char **argv) : _jobs(LATENCY_JOBS) {
+        std::string flag = LATENCY_JOBS_FLAG;
+        for (int i = 1; i < argc; i++) {
+            if (strncmp(argv[i], flag.c_str(), flag.size()) == 0) {
+                _jobs = atoi(argv[i] + flag.size());
+            }
+        }
+        if (getenv(LATENCY_CHILD_ENV)) {
+            _jobs = 0;
+        }
+    }
+
+    /*!
+     * Pick the tagged tests that pass the current filter, take them out of
+     * this process's run and run them, returning once they have all finished
+     * or been killed.
+     */
+    void start() {
+        if (_jobs <= 0 || latency_bound_patterns().empty()) {
+            return;
+        }
+        std::string filter = ::testing::GTEST_FLAG(filter);
+        const ::testing::UnitTest &unit_test = *::testing::UnitTest::GetInstance();
+        for (int i = 0; i < unit_test.total_test_case_count(); i++) {
+            const ::testing::TestCase &test_case = *unit_test.GetTestCase(i);
+            for (int j = 0; j < test_case.total_test_count(); j++) {
+                std::string name = std::string(test_case.name()) + "." + test_case.GetTestInfo(j)->name();
+                for (const std::string &pattern : latency_bound_patterns()) {
+                    if (latency_glob(pattern.c_str(), name.c_str()) && latency_matches_filter(name, filter)) {
+                        _children.push_back(Child(name));
+                        break;
+                    }
+                }
+            }
+        }
+        if (_children.empty()) {
+            return;
+        }
+
+        std::string excluded;
+        for (const std::string &pattern : latency_bound_patterns()) {
+            excluded += (excluded.empty() ? "" : ":") + pattern;
+        }
+        ::testing::GTEST_FLAG(filter) = filter + (filter.find('-') == std::string::npos ? "-" : ":") + excluded;
+        run_pool();
+    }
+
+    /*!
+     * Print the output of the tagged tests and add their results to the
+     * counts from the main run.
+     * @return non-zero if any of them failed
+     */
+    int finish(int &num_success, int &num_failures) {
+        int result = 0;
+        for (Child &child : _children) {
+            std::ifstream output(child.output);
+            std::string line;
+            bool graded = false;
+            while (std::getline(output, line)) {
+                if (line.compare(0, strlen(LATENCY_GRADE_PATTERN), LATENCY_GRADE_PATTERN) == 0) {
+                    int passed = 0, total = 0;
+                    sscanf(line.c_str() + strlen(LATENCY_GRADE_PATTERN), "%d/%d", &passed, &total);
+                    num_success += passed;
+                    num_failures += total - passed;
+                    graded = true;
+                } else {
+                    std::cout << line << std::endl;
+                }
+            }
+            if (!graded) {
+                std::cout << "[  FAILED  ] " << child.name
+                          << (child.killed ? " did not finish within " + std::to_string(LATENCY_CHILD_SECONDS) + " s"
+                                           : " did not finish") << std::endl;
+                num_failures++;
+            }
+            if (!graded || !WIFEXITED(child.status) || WEXITSTATUS(child.status) != 0) {
+                result = 1;
+            }
+            remove(child.output.c_str());
+        }
+        return result;
+    }
+
+private:
+    struct Child {
+        explicit Child(const std::string &n) : name(n), pid(-1), status(0), started(0), killed(false) {}
+        std::string name, output;
+        pid_t pid;
+        int status;
+        time_t started;
+        bool killed;  // ran out of time
+    };
+
+    int _jobs;
+    std::vector<Child> _children;
+
+    void spawn(Child &child) {
+        char path[] = "/tmp/latency_bound_XXXXXX";
+        int fd = mkstemp(path);
+        child.output = path;
+
+        std::string filter = "--gtest_filter=" + child.name;
+        char *argv[] = {(char *) "/proc/self/exe", (char *) filter.c_str(), NULL};
+        std::vector<char *> env;
+        std::string marker = std::string(LATENCY_CHILD_ENV) + "=1";
+        for (char **e = environ; *e; e++) {
+            env.push_back(*e);
+        }
+        env.push_back((char *) marker.c_str());
+        env.push_back(NULL);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fd, 1);
+        posix_spawn_file_actions_adddup2(&actions, fd, 2);
+        if (posix_spawn(&child.pid, argv[0], &actions, NULL, argv, env.data()) != 0) {
+            child.pid = -1;
+        }
+        posix_spawn_file_actions_destroy(&actions);
+        close(fd);
+        child.started = time(NULL);
+    }
+
+    /*!
+     * Keep up to _jobs children running until all have finished, killing
+     * those that run out of time. Only our own children are waited for, so
+     * death tests in the main process are not disturbed.
+     */
+    void run_pool() {
+        size_t next = 0, done = 0;
+        std::vector<Child *> running;
+        while (done < _children.size()) {
+            while (next < _children.size() && (int) running.size() < _jobs) {
+                spawn(_children[next]);
+                if (_children[next].pid > 0) {
+                    running.push_back(&_children[next]);
+                } else {
+                    done++;
+                }
+                next++;
+            }
+            for (size_t i = 0; i < running.size();) {
+                if (waitpid(running[i]->pid, &running[i]->status, WNOHANG) == running[i]->pid) {
+                    running.erase(running.begin() + i);
+                    done++;
+                } else {
+                    if (!running[i]->killed && time(NULL) - running[i]->started > LATENCY_CHILD_SECONDS) {
+                        kill(running[i]->pid, SIGKILL);
+                        running[i]->killed = true;
+                    }
+                    i++;
+                }
+            }
+            usleep(5000);
+        }
+    }
+};
+
+#endif //ECE590_LATENCY_BOUND_H
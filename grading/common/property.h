@@ -0,0 +1,282 @@
+// Property-based testing with shrinking.
+
+#ifndef ECE590_PROPERTY_H
+#define ECE590_PROPERTY_H
+
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+
+#define PROPERTY_RUNS 2000        // inputs generated per property
+#define PROPERTY_SEED 590         // fixed, so every student is checked against the same inputs
+#define PROPERTY_MAX_SIZE 100     // size hint reached by the last generated input
+#define PROPERTY_MAX_SHRINKS 1000 // give up shrinking after this many successful steps
+
+/*
+ * Instead of listing inputs with testing::Values, a test states a property
+ * that must hold for every input and how to generate inputs:
+ *
+ *     ASSERT_PROPERTY(gen_vector(gen_int(INT_MIN, INT_MAX)), [](const vector<int> &v) {
+ *         ...call the student's code...
+ *         return ok;
+ *     });
+ *
+ * PROPERTY_RUNS inputs are generated inside the one test, starting small and
+ * growing. At the first input that breaks the property, the input is shrunk
+ * (shorter vectors, values closer to zero) for as long as the property still
+ * fails, and the test fails with the smallest counterexample found.
+ */
+template<typename T>
+struct Gen {
+    // a random value; size grows from 0 to PROPERTY_MAX_SIZE over a run
+    std::function<T(std::mt19937 &, int size)> generate;
+    // simpler candidates for a value, simplest first
+    std::function<std::vector<T>(const T &)> shrink;
+};
+
+/*!
+ * Integers in [min, max]. Half of the values are within size of zero, which
+ * gives repeated values, and some are the bounds themselves.
+ */
+inline Gen<int> gen_int(int min, int max) {
+    int target = std::min(std::max(0, min), max);
+    Gen<int> g;
+    g.generate = [=](std::mt19937 &rng, int size) {
+        switch (rng() % 8) {
+            case 0:
+                return rng() & 1 ? min : max;
+            case 1:
+            case 2:
+            case 3: {
+                long long lo = std::max((long long) min, (long long) target - size);
+                long long hi = std::min((long long) max, (long long) target + size);
+                return (int) std::uniform_int_distribution<long long>(lo, hi)(rng);
+            }
+            default:
+                return std::uniform_int_distribution<int>(min, max)(rng);
+        }
+    };
+    g.shrink = [=](const int &x) {
+        std::vector<int> candidates;
+        if (x != target) {
+            long long diff = (long long) x - target;
+            candidates.push_back(target);
+            if (diff / 2 != 0) {
+                candidates.push_back((int) (target + diff / 2));
+            }
+            if (diff > 1 || diff < -1) {
+                candidates.push_back((int) (x - (diff > 0 ? 1 : -1)));
+            }
+        }
+        return candidates;
+    };
+    return g;
+}
+
+/*!
+ * Doubles in [min, max], shrinking towards zero and then towards whole numbers.
+ */
+inline Gen<double> gen_real(double min, double max) {
+    double target = std::min(std::max(0.0, min), max);
+    Gen<double> g;
+    g.generate = [=](std::mt19937 &rng, int size) {
+        if (rng() % 8 == 0) {
+            return rng() & 1 ? min : max;
+        }
+        if (rng() % 2 == 0) {
+            double lo = std::max(min, target - size), hi = std::min(max, target + size);
+            return std::uniform_real_distribution<double>(lo, hi)(rng);
+        }
+        return std::uniform_real_distribution<double>(min, max)(rng);
+    };
+    g.shrink = [=](const double &x) {
+        std::vector<double> candidates;
+        if (x != target) {
+            candidates.push_back(target);
+            if (trunc(x) != x && trunc(x) >= min && trunc(x) <= max) {
+                candidates.push_back(trunc(x));
+            }
+            if (fabs(x - target) > 1e-6) {
+                candidates.push_back(target + (x - target) / 2);
+            }
+        }
+        return candidates;
+    };
+    return g;
+}
+
+/*!
+ * Vectors of up to max_length elements, shrinking by dropping elements and
+ * then by shrinking the elements themselves.
+ */
+template<typename T>
+Gen<std::vector<T>> gen_vector(Gen<T> element, int max_length = PROPERTY_MAX_SIZE) {
+    Gen<std::vector<T>> g;
+    g.generate = [=](std::mt19937 &rng, int size) {
+        int length = std::uniform_int_distribution<int>(0, std::min(size, max_length))(rng);
+        std::vector<T> v;
+        v.reserve(length);
+        for (int i = 0; i < length; i++) {
+            v.push_back(element.generate(rng, size));
+        }
+        return v;
+    };
+    g.shrink = [=](const std::vector<T> &v) {
+        std::vector<std::vector<T>> candidates;
+        size_t n = v.size();
+        if (n == 0) {
+            return candidates;
+        }
+        candidates.push_back(std::vector<T>());
+        if (n > 1) {
+            candidates.push_back(std::vector<T>(v.begin(), v.begin() + n / 2));
+            candidates.push_back(std::vector<T>(v.begin() + n / 2, v.end()));
+        }
+        for (size_t i = 0; i < n; i++) {
+            std::vector<T> removed(v);
+            removed.erase(removed.begin() + i);
+            candidates.push_back(removed);
+        }
+        for (size_t i = 0; i < n; i++) {
+            for (const T &smaller : element.shrink(v[i])) {
+                std::vector<T> changed(v);
+                changed[i] = smaller;
+                candidates.push_back(changed);
+            }
+        }
+        return candidates;
+    };
+    return g;
+}
+
+/*!
+ * Pairs, shrinking the first element and then the second.
+ */
+template<typename A, typename B>
+Gen<std::pair<A, B>> gen_pair(Gen<A> first, Gen<B> second) {
+    Gen<std::pair<A, B>> g;
+    g.generate = [=](std::mt19937 &rng, int size) {
+        A a = first.generate(rng, size);
+        return std::make_pair(a, second.generate(rng, size));
+    };
+    g.shrink = [=](const std::pair<A, B> &p) {
+        std::vector<std::pair<A, B>> candidates;
+        for (const A &a : first.shrink(p.first)) {
+            candidates.push_back(std::make_pair(a, p.second));
+        }
+        for (const B &b : second.shrink(p.second)) {
+            candidates.push_back(std::make_pair(p.first, b));
+        }
+        return candidates;
+    };
+    return g;
+}
+
+template<typename T> void property_print(std::ostream &os, const T &x);
+template<typename A, typename B> void property_print(std::ostream &os, const std::pair<A, B> &p);
+template<typename T> void property_print(std::ostream &os, const std::vector<T> &v);
+
+template<typename T>
+void property_print(std::ostream &os, const T &x) {
+    os << x;
+}
+
+template<typename A, typename B>
+void property_print(std::ostream &os, const std::pair<A, B> &p) {
+    os << "(";
+    property_print(os, p.first);
+    os << ", ";
+    property_print(os, p.second);
+    os << ")";
+}
+
+template<typename T>
+void property_print(std::ostream &os, const std::vector<T> &v) {
+    os << "{";
+    for (size_t i = 0; i < v.size(); i++) {
+        os << (i ? ", " : "");
+        property_print(os, v[i]);
+    }
+    os << "}";
+}
+
+template<typename T>
+std::string property_show(const T &x) {
+    std::ostringstream os;
+    os << std::setprecision(17);
+    property_print(os, x);
+    return os.str();
+}
+
+struct PropertyResult {
+    bool passed;
+    int tests;               // inputs checked before the first failure
+    int shrinks;             // successful shrinking steps
+    std::string original;    // first failing input
+    std::string counterexample; // smallest failing input found
+
+    std::string report() const {
+        std::ostringstream os;
+        os << "Property failed after " << tests << " inputs." << std::endl
+           << "Counterexample: " << counterexample << std::endl
+           << "(shrunk in " << shrinks << " steps from " << original << ")";
+        return os.str();
+    }
+};
+
+/*!
+ * Check that property(x) holds for generated inputs x
+ * @param gen
+ * @param property callable returning true when the property holds
+ * @param runs number of inputs to generate
+ * @param seed
+ * @return
+ */
+template<typename T, typename Property>
+PropertyResult check_property(const Gen<T> &gen, Property property, int runs = PROPERTY_RUNS,
+                              unsigned seed = PROPERTY_SEED) {
+    std::mt19937 rng(seed);
+    PropertyResult result = {true, 0, 0, "", ""};
+    for (int i = 0; i < runs; i++) {
+        T x = gen.generate(rng, runs > 1 ? i * PROPERTY_MAX_SIZE / (runs - 1) : PROPERTY_MAX_SIZE);
+        result.tests++;
+        if (property(x)) {
+            continue;
+        }
+        result.passed = false;
+        result.original = property_show(x);
+        bool smaller = true;
+        while (smaller && result.shrinks < PROPERTY_MAX_SHRINKS) {
+            smaller = false;
+            for (const T &candidate : gen.shrink(x)) {
+                if (!property(candidate)) {
+                    x = candidate;
+                    result.shrinks++;
+                    smaller = true;
+                    break;
+                }
+            }
+        }
+        result.counterexample = property_show(x);
+        break;
+    }
+    return result;
+}
+
+// variadic so the property lambda may contain commas
+#define ASSERT_PROPERTY(gen, ...) { \
+    PropertyResult _property_result = check_property(gen, __VA_ARGS__); \
+    if (!_property_result.passed) { \
+        FAIL() << _property_result.report(); \
+    } \
+    std::cout << "Property held for " << _property_result.tests << " inputs" << std::endl; \
+}
+
+#endif //ECE590_PROPERTY_H
@@ -0,0 +1,58 @@
+// Per-test results for the grading scripts.
+
+#ifndef ECE590_TEST_RESULTS_H
+#define ECE590_TEST_RESULTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include "latency_bound.h"
+#include "alloc_stats.h"
+
+#define TEST_RESULTS_FILE "TestResults.tsv" // written next to the test binary, read by grade.sh
+
+/*
+ * Besides the log, the listener in main.cc writes one line per test to
+ * TEST_RESULTS_FILE,
+ *
+ *     MatrixTests.Get<TAB>1<TAB>12<TAB>3<TAB>96<TAB>64
+ *
+ * with the full test name, 1 if it passed or 0 if it failed, its time in
+ * milliseconds, and the number of heap allocations, bytes allocated and peak
+ * heap use of the test. The last three are empty unless the binary is built
+ * with ALLOC_STATS=1. grade.sh loads these lines into results/results.db, so
+ * the results of a run can be queried without parsing the logs.
+ *
+ * The file is emptied when the test binary starts. Latency-bound tests,
+ * which run in child processes, append to the file of their parent.
+ */
+inline void test_results_start() {
+    if (!getenv(LATENCY_CHILD_ENV)) {
+        FILE *file = fopen(TEST_RESULTS_FILE, "w");
+        if (file) {
+            fclose(file);
+        }
+    }
+}
+
+/*!
+ * @param test_info
+ * @param allocations heap allocations of the test, NULL when they are not counted
+ */
+inline void test_results_record(const ::testing::TestInfo &test_info, const AllocScope *allocations) {
+    // read before fopen, which allocates
+    char allocated[64] = "\t\t";
+    if (allocations) {
+        snprintf(allocated, sizeof(allocated), "%ld\t%ld\t%ld", allocations->count(), allocations->bytes(),
+                 allocations->peak());
+    }
+    // opened for each test, so each line is a single append even with children writing too
+    FILE *file = fopen(TEST_RESULTS_FILE, "a");
+    if (file) {
+        fprintf(file, "%s.%s\t%d\t%lld\t%s\n", test_info.test_case_name(), test_info.name(),
+                test_info.result()->Failed() ? 0 : 1, (long long) test_info.result()->elapsed_time(), allocated);
+        fclose(file);
+    }
+}
+
+#endif //ECE590_TEST_RESULTS_H
@@ -10,6 +10,9 @@
 #include "complex.h"
 #include <fstream>
 #include <vector>
+#include <chrono>
+#include <random>
+#include <limits.h>
 
 
 
@@ -21,6 +24,8 @@ using std::vector;
 #define Q1POINTS 100.0
 #define Q2POINTS 100.0
 #define NUM_QUESTIONS 2 // overestimated number of questions
+#define REDUCE_BULK_PAIRS (1 << 21) // number of (num, den) pairs checked by FractionBulkTests
+#define REDUCE_BULK_SECONDS 20.0    // stop the bulk check early after this long (e.g. a brute force reduce)
 #define GTEST_COUT_GRADE std::cerr       << "[    GRADE ] "
 
 /*
@@ -285,6 +290,57 @@ protected:
  * Question 1: reduce *************************************************
  */
 
+/*!
+ * Greatest common divisor by Stein's binary algorithm: only shifts and
+ * subtractions, so checking millions of pairs stays cheap.
+ * @param u
+ * @param v
+ * @return gcd(u, v), with gcd(0, v) = v
+ */
+unsigned binary_gcd(unsigned u, unsigned v) {
+    if (u == 0) {
+        return v;
+    }
+    if (v == 0) {
+        return u;
+    }
+    int shift = __builtin_ctz(u | v);
+    u >>= __builtin_ctz(u);
+    do {
+        v >>= __builtin_ctz(v);
+        if (u > v) {
+            std::swap(u, v);
+        }
+        v -= u;
+    } while (v != 0);
+    return u << shift;
+}
+
+/*!
+ * What reduce should return: 0/0 and x/x have fixed answers, 0/x is 0/1,
+ * x/0 is 1/0 and otherwise the sign moves to the numerator and both
+ * parts are divided by their gcd. INT_MIN is not a valid input.
+ * @param a
+ * @return
+ */
+Fraction reference_reduce(Fraction a) {
+    if (a.num == 0 && a.den == 0) {
+        return (Fraction) {0, 0};
+    }
+    if (a.num == a.den) {
+        return (Fraction) {1, 1};
+    }
+    if (a.num == 0) {
+        return (Fraction) {0, 1};
+    }
+    if (a.den == 0) {
+        return (Fraction) {1, 0};
+    }
+    int sign = a.den < 0 ? -1 : 1;
+    int gcf = (int) binary_gcd((unsigned) abs(a.num), (unsigned) abs(a.den));
+    return (Fraction) {sign * a.num / gcf, sign * a.den / gcf};
+}
+
 class FractionTests : public Question1,
                     public ::testing::WithParamInterface<std::tuple<int, int>> {
 };
@@ -299,46 +355,8 @@ TEST_P(FractionTests, Reduce) {
 
     // Call the student's api
     Fraction result = reduce(a);
-    Fraction expected;
-
-    if (a.num == 0 && a.den == 0) {
-        ASSERT_EQ(result.num, 0);
-        ASSERT_EQ(result.den, 0);
-        return;
-    }
-
-    if (a.num == a.den ) {
-        ASSERT_EQ(result.num, 1);
-        ASSERT_EQ(result.den, 1);
-        return;
-    }
-
-    if (a.num == 0 ) {
-        ASSERT_EQ(result.num, 0);
-        ASSERT_EQ(result.den, 1);
-        return;
-    }
-
-    if (a.den == 0) {
-        ASSERT_EQ(result.num, 1);
-        ASSERT_EQ(result.den, 0);
-        return;
-    }
+    Fraction expected = reference_reduce(a);
 
-    int sign = 1;
-    if (a.den < 0){ 
-        sign = -1;
-    }
-
-    int gcf, i = 1;
-    while (i <= abs(a.num) && i <= abs(a.den)){
-        if (a.num % i == 0 && a.den % i == 0){ 
-            gcf = i;
-        }
-        i++;
-    }
-
-    expected = (Fraction) {sign * a.num / gcf, sign * a.den / gcf};
     ASSERT_EQ(result.num, expected.num);
     ASSERT_EQ(result.den, expected.den);
 };
@@ -353,6 +371,69 @@ INSTANTIATE_TEST_CASE_P(FractionTests,
             testing::Values(0,-500, 500, 10, 330, -12, 15, -4, 4, 495, -645))
 );
 
+/*
+ * Checks reduce against reference_reduce on REDUCE_BULK_PAIRS pairs in a
+ * single test. Pairs come from a fixed seed so every student sees the same
+ * inputs: magnitudes are spread evenly over bit lengths, about a quarter of
+ * the pairs share a large common factor and some are built from edge
+ * values. Stops at the first mismatch, or after REDUCE_BULK_SECONDS.
+ */
+class FractionBulkTests : public Question1 {
+protected:
+    std::mt19937 gen{590};
+
+    int random_part() {
+        int bits = std::uniform_int_distribution<int>(0, 31)(gen);
+        unsigned max = bits == 31 ? INT_MAX : (1u << bits);
+        int x = (int) std::uniform_int_distribution<unsigned>(0, max)(gen);
+        return gen() & 1 ? -x : x;
+    }
+
+    int edge_part() {
+        static const int edges[] = {0, 1, -1, 2, -2, 3, 7, -13, 1 << 30, -(1 << 30),
+                                    INT_MAX, -INT_MAX, INT_MAX - 1, 65536, 46341, -2147483629};
+        return edges[gen() % (sizeof(edges) / sizeof(edges[0]))];
+    }
+
+    Fraction random_pair() {
+        switch (gen() % 8) {
+            case 0:
+                return (Fraction) {edge_part(), edge_part()};
+            case 1:
+                return (Fraction) {edge_part(), random_part()};
+            case 2:
+            case 3: {
+                // common factor f, with both parts kept below INT_MAX
+                int f = 1 + (int) (gen() % 100000);
+                int limit = INT_MAX / f;
+                int n = (int) (gen() % (limit + 1u)), d = (int) (gen() % (limit + 1u));
+                return (Fraction) {(gen() & 1 ? -n : n) * f, (gen() & 1 ? -d : d) * f};
+            }
+            default:
+                return (Fraction) {random_part(), random_part()};
+        }
+    }
+};
+
+TEST_F(FractionBulkTests, ReduceRandom) {
+    auto start = std::chrono::steady_clock::now();
+    int checked = 0;
+    for (; checked < REDUCE_BULK_PAIRS; checked++) {
+        // checked on every pair: a brute force reduce can take tens of ms per pair
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > REDUCE_BULK_SECONDS) {
+            break;
+        }
+        Fraction a = random_pair();
+        Fraction result = reduce(a);
+        Fraction expected = reference_reduce(a);
+        if (result.num != expected.num || result.den != expected.den) {
+            FAIL() << "reduce({" << a.num << ", " << a.den << "}) returned {" << result.num << ", " << result.den
+                   << "}, expected {" << expected.num << ", " << expected.den << "} (pair " << checked << ")";
+        }
+    }
+    std::cout << "Checked " << checked << " pairs" << std::endl;
+}
+
 /*
  * Question 2 *************************************************
  */
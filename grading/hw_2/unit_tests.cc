@@ -9,7 +9,10 @@
 #include "solutions.h"
 #include "rpn.h"
 #include "limits.h"
+#include "property.h"
+#include "alloc_stats.h"
 #include <vector>
+#include <chrono>
 
 
 using std::string;
@@ -23,6 +26,8 @@ using std::vector;
 #define Q4POINTS 100.0
 #define Q5POINTS 100.0
 #define Q6POINTS 100.0
+#define RPN_STRESS_VALUES (1 << 22) // values pushed, then popped, by RpnStressTests
+#define RPN_STRESS_SECONDS 10.0     // time allowed for all the pushes and pops
 #define NUM_QUESTIONS 6 // overestimated number of questions
 #define GTEST_COUT_GRADE std::cerr       << "[    GRADE ] "
 
@@ -404,6 +409,21 @@ INSTANTIATE_TEST_CASE_P(ReverseInPlaceTests,
         testing::ValuesIn(tvForRevInPlace)
 );
 
+/*
+ * Property versions of the tests, checking PROPERTY_RUNS generated arrays
+ * each and reporting a shrunk counterexample on failure.
+ */
+class ReversePropertyTests : public Question2 {
+};
+
+TEST_F(ReversePropertyTests, ReverseInPlace) {
+    ASSERT_PROPERTY(gen_vector(gen_int(INT_MIN, INT_MAX)), [](const vector<int> &v) {
+        vector<int> testArray(v);
+        reverse_in_place(testArray.data(), testArray.size());
+        return std::equal(v.rbegin(), v.rend(), testArray.begin());
+    });
+};
+
 /*
  * Question 3 *************************************************
  */
@@ -437,6 +457,19 @@ INSTANTIATE_TEST_CASE_P(ReverseTests,
         testing::ValuesIn(tvForRevInPlace)
 );
 
+class ReverseCopyPropertyTests : public Question3 {
+};
+
+TEST_F(ReverseCopyPropertyTests, Reverse) {
+    ASSERT_PROPERTY(gen_vector(gen_int(INT_MIN, INT_MAX)), [](const vector<int> &v) {
+        vector<int> testArray(v);
+        int *result = reverse(testArray.data(), testArray.size());
+        bool reversed = v.empty() || std::equal(v.rbegin(), v.rend(), result);
+        free(result);
+        return reversed;
+    });
+};
+
 /*
  * Question 4 *************************************************
  */
@@ -481,6 +514,18 @@ INSTANTIATE_TEST_CASE_P(NumInstancesTests,
         testing::ValuesIn(tvForNumInst)
 );
 
+class NumInstancesPropertyTests : public Question4 {
+};
+
+TEST_F(NumInstancesPropertyTests, NumInstances) {
+    auto gen = gen_pair(gen_vector(gen_int(INT_MIN, INT_MAX)), gen_int(INT_MIN, INT_MAX));
+    ASSERT_PROPERTY(gen, [](const std::pair<vector<int>, int> &p) {
+        vector<int> arr(p.first);
+        int result = num_instances(arr.data(), arr.size(), p.second);
+        return result == std::count(p.first.begin(), p.first.end(), p.second);
+    });
+};
+
 /*
  * Question 5 *************************************************
  */
@@ -590,6 +635,80 @@ TEST_F(BaseRpnTests, Reallocation) {
     rpn_free();
 };
 
+/*
+ * Pushes RPN_STRESS_VALUES values and pops them all back. A stack that grows
+ * by a fixed amount copies itself on every growth and runs out of time; the
+ * pushes are checked against the clock at every doubling, so it fails
+ * without stalling the run. Only the time is graded; how the stack grows
+ * is checked by RpnGrowthTests in ALLOC_STATS=1 runs alone.
+ */
+class RpnStressTests : public Question6 {
+};
+
+TEST_F(RpnStressTests, MillionsOfPushesAndPops) {
+    auto start = std::chrono::steady_clock::now();
+    auto seconds = [&start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    rpn_init();
+    int pushed = 0;
+    for (int target = 1024; target <= RPN_STRESS_VALUES; target *= 2) {
+        for (; pushed < target; pushed++) {
+            rpn_push(pushed);
+        }
+        if (seconds() > RPN_STRESS_SECONDS) {
+            rpn_free();
+            FAIL() << "Only " << pushed << " pushes in " << seconds() << " s";
+        }
+    }
+    for (int i = pushed - 1; i >= 0; i--) {
+        double x = rpn_pop();
+        if (x != i) {
+            rpn_free();
+            FAIL() << "Popped " << x << ", expected " << i;
+        }
+    }
+    EXPECT_EQ(rpn_error(), OK);
+    rpn_free();
+
+    double elapsed = seconds();
+    std::cout << pushed << " pushes and pops in " << elapsed << " s" << std::endl;
+    EXPECT_LE(elapsed, RPN_STRESS_SECONDS);
+};
+
+#ifdef GRADE_ALLOC_STATS
+/*
+ * Counts the allocations, realloc included, of RPN_STRESS_VALUES pushes.
+ * Growing geometrically needs about log2(RPN_STRESS_VALUES) of them; the
+ * count is checked at every doubling, so a stack that grows by a fixed
+ * amount fails early. The count comes from the ALLOC_STATS=1 hooks, so this
+ * is not part of the default grade.
+ */
+class RpnGrowthTests : public Question6 {
+};
+
+TEST_F(RpnGrowthTests, GrowsGeometrically) {
+    long limit = 3 * (long) log2(RPN_STRESS_VALUES) + 16;
+    rpn_init();
+    AllocScope allocations;
+    int pushed = 0;
+    for (int target = 1024; target <= RPN_STRESS_VALUES; target *= 2) {
+        for (; pushed < target; pushed++) {
+            rpn_push(pushed);
+        }
+        if (allocations.count() > limit) {
+            rpn_free();
+            FAIL() << allocations.count() << " allocations for " << pushed
+                   << " pushes, the stack does not grow geometrically";
+        }
+    }
+    std::cout << allocations.count() << " allocations for " << pushed << " pushes, peak "
+              << allocations.peak() << " bytes" << std::endl;
+    rpn_free();
+};
+#endif
+
 //Param A random name, Param B test class and Param C list of inputs.
 INSTANTIATE_TEST_CASE_P(RpnTests,
         RpnTests,
@@ -9,7 +9,10 @@
 #include "complex.h"
 #include "typed_array.h"
 #include "limits.h"
+#include "property.h"
+#include "complexity.h"
 #include <vector>
+#include <functional>
 
 
 using std::string;
@@ -23,6 +26,8 @@ using std::vector;
 #define Q4POINTS 100.0
 #define Q5POINTS 100.0
 #define Q6POINTS 100.0
+#define GROWTH_MIN_SIZE 500   // smallest array in the growth tests, doubled GROWTH_STEPS times
+#define GROWTH_STEPS 6
 #define NUM_QUESTIONS 6 // overestimated number of questions
 #define GTEST_COUT_GRADE std::cerr       << "[    GRADE ] "
 
@@ -414,6 +419,89 @@ INSTANTIATE_TEST_CASE_P(TypedArrayBasicTests,
         testing::Range(0, 900, 300)
 );
 
+/*
+ * Element type that counts every construction and assignment a container
+ * performs on it. The number of element operations needed for n calls to an
+ * amortized O(1) method grows like n, while an array that is reallocated
+ * or shifted on every call needs about n^2.
+ */
+struct Counted {
+    static long operations;
+    int value;
+
+    Counted() : value(0) { operations++; }
+    Counted(int v) : value(v) {}
+    Counted(const Counted &other) : value(other.value) { operations++; }
+    Counted(Counted &&other) : value(other.value) { operations++; }
+    Counted &operator=(const Counted &other) { value = other.value; operations++; return *this; }
+    Counted &operator=(Counted &&other) { value = other.value; operations++; return *this; }
+};
+
+long Counted::operations = 0;
+
+/*
+ * Growth tests run an operation n times (or once on arrays of size n, for
+ * concat) for geometrically increasing n and check that the number of
+ * element operations grows linearly in n. The sizes double at each step,
+ * so an array whose capacity doubles is at the same point of its growth at
+ * every size and its reallocations add the same share of operations to
+ * each count. The counts are exact, so each size is run once.
+ */
+class TypedArrayGrowthTests : public Question1 {
+};
+
+class TypedArrayConcatGrowthTests : public Question2 {
+};
+
+TEST_F(TypedArrayGrowthTests, Push) {
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(GROWTH_MIN_SIZE, GROWTH_STEPS), [](int n) {
+        TypedArray<Counted> a;
+        Counted::operations = 0;
+        for (int i = 0; i < n; i++) {
+            a.push(Counted(i));
+        }
+        return (double) Counted::operations;
+    }, 1);
+};
+
+TEST_F(TypedArrayGrowthTests, PushFront) {
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(GROWTH_MIN_SIZE, GROWTH_STEPS), [](int n) {
+        TypedArray<Counted> a;
+        Counted::operations = 0;
+        for (int i = 0; i < n; i++) {
+            a.push_front(Counted(i));
+        }
+        return (double) Counted::operations;
+    }, 1);
+};
+
+TEST_F(TypedArrayGrowthTests, PopFront) {
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(GROWTH_MIN_SIZE, GROWTH_STEPS), [](int n) {
+        TypedArray<Counted> a;
+        for (int i = 0; i < n; i++) {
+            a.push(Counted(i));
+        }
+        Counted::operations = 0;
+        for (int i = 0; i < n; i++) {
+            a.pop_front();
+        }
+        return (double) Counted::operations;
+    }, 1);
+};
+
+TEST_F(TypedArrayConcatGrowthTests, Concat) {
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(GROWTH_MIN_SIZE, GROWTH_STEPS), [](int n) {
+        TypedArray<Counted> a, b;
+        for (int i = 0; i < n; i++) {
+            a.push(Counted(i));
+            b.push(Counted(-i));
+        }
+        Counted::operations = 0;
+        TypedArray<Counted> c = a.concat(b);
+        return (double) Counted::operations;
+    }, 1);
+};
+
 /*
  * Question 2 *************************************************
  */
@@ -463,6 +551,39 @@ INSTANTIATE_TEST_CASE_P(TypedArrayConcatTests,
         testing::ValuesIn(concatTestVev)
 );
 
+/*
+ * Property version of the concat test: for PROPERTY_RUNS generated pairs of
+ * arrays, a.concat(b) holds a then b and leaves both unchanged. Failures
+ * report a shrunk counterexample.
+ */
+class TypedArrayConcatPropertyTests : public Question2 {
+};
+
+TEST_F(TypedArrayConcatPropertyTests, Concat) {
+    auto gen = gen_pair(gen_vector(gen_real(-1e6, 1e6)), gen_vector(gen_real(-1e6, 1e6)));
+    ASSERT_PROPERTY(gen, [](const std::pair<vector<double>, vector<double>> &p) {
+        TypedArray<double> a, b;
+        for (int i = 0; i < (int) p.first.size(); i++) {
+            a.set(i, p.first[i]);
+        }
+        for (int i = 0; i < (int) p.second.size(); i++) {
+            b.set(i, p.second[i]);
+        }
+        TypedArray<double> c = a.concat(b);
+        if (c.size() != (int) (p.first.size() + p.second.size()) ||
+            a.size() != (int) p.first.size() || b.size() != (int) p.second.size()) {
+            return false;
+        }
+        for (int i = 0; i < c.size(); i++) {
+            double expected = i < a.size() ? p.first[i] : p.second[i - a.size()];
+            if (c.get(i) != expected) {
+                return false;
+            }
+        }
+        return true;
+    });
+};
+
 /*
  * Question 3 *************************************************
  */
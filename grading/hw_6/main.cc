@@ -1,5 +1,10 @@
 #include <stdio.h>
 #include "gtest/gtest.h"
+#include "latency_bound.h"
+#define ALLOC_STATS_IMPLEMENTATION // before test_results.h, which includes alloc_stats.h too
+#include "alloc_stats.h"
+#include "test_results.h"
+#include "progress.h"
 
 using namespace testing;
 
@@ -51,6 +56,11 @@ public:
      */
     int num_tests;
 
+    /**
+     * Heap allocations of the running test, when built with ALLOC_STATS=1
+     */
+    AllocScope* allocations;
+
     explicit ConfigurableEventListener(TestEventListener* theEventListener) : eventListener(theEventListener)
     {
         showTestCases = true;
@@ -60,6 +70,7 @@ public:
         showEnvironment = true;
         num_success = 0;
         num_failures = 0;
+        allocations = NULL;
     }
 
     virtual ~ConfigurableEventListener()
@@ -69,6 +80,7 @@ public:
 
     virtual void OnTestProgramStart(const UnitTest& unit_test)
     {
+        progress_event("tests", std::to_string(unit_test.test_to_run_count()));
         eventListener->OnTestProgramStart(unit_test);
     }
 
@@ -103,9 +115,13 @@ public:
     virtual void OnTestStart(const TestInfo& test_info)
     {
         std::cout << "POINTS: " << num_success << std::endl;
+        progress_event("test_start", std::string(test_info.test_case_name()) + "." + test_info.name());
         if(showTestNames) {
             eventListener->OnTestStart(test_info);
         }
+        if(alloc_stats_enabled()) {
+            allocations = new AllocScope();
+        }
     }
 
     virtual void OnTestPartResult(const TestPartResult& result)
@@ -115,6 +131,16 @@ public:
 
     virtual void OnTestEnd(const TestInfo& test_info)
     {
+        if(allocations) {
+            printf("ALLOCATIONS: count=%ld bytes=%ld peak=%ld\n", allocations->count(), allocations->bytes(), allocations->peak());
+        }
+        test_results_record(test_info, allocations);
+        if(allocations) {
+            delete allocations;
+            allocations = NULL;
+        }
+        progress_event("test_end", std::string(test_info.test_case_name()) + "." + test_info.name()
+                       + (test_info.result()->Failed() ? "\t0" : "\t1"));
         if((showInlineFailures && test_info.result()->Failed()) || (showSuccesses && !test_info.result()->Failed())) {
             eventListener->OnTestEnd(test_info);
         }
@@ -157,7 +183,6 @@ public:
     virtual void OnTestProgramEnd(const UnitTest& unit_test)
     {
         eventListener->OnTestProgramEnd(unit_test);
-        printf("\nHOMEWORK_GRADE: %d/%d\n", num_success, num_failures+num_success);
     }
 
 };
@@ -181,6 +206,12 @@ int main(int argc, char **argv)
     listener->showInlineFailures = true;
     listeners.Append(listener);
 
-    // run
-    return RUN_ALL_TESTS();
+    // run, with latency-bound tests overlapped in child processes
+    LatencyBoundRunner latency(argc, argv);
+    test_results_start();
+    latency.start();
+    int result = RUN_ALL_TESTS();
+    result |= latency.finish(listener->num_success, listener->num_failures);
+    printf("\nHOMEWORK_GRADE: %d/%d\n", listener->num_success, listener->num_failures+listener->num_success);
+    return result;
 }
\ No newline at end of file
@@ -11,6 +11,8 @@
 #include "integrator.h"
 #include "derivative.h"
 #include "limits.h"
+#include "virtual_clock.h"
+#include "latency_bound.h"
 #include <vector>
 
 
@@ -307,20 +309,38 @@ protected:
  * Question 1: stopwatch *************************************************
  */
 
+/*
+ * The stopwatch tests run against a virtual clock: while the fixture is
+ * alive, SLEEP_THREAD advances the process clocks instead of blocking, so
+ * each test takes microseconds and the elapsed times are exact.
+ * StopwatchRealTimeTests repeats the basic test once in real time. It is not
+ * a Question, so it does not change the question breakdown, but like every
+ * test it counts in HOMEWORK_GRADE.
+ */
 class StopwatchTests : public Question1,
                     public ::testing::WithParamInterface<int> {
+protected:
+    VirtualClock clock;
 };
 
+class StopwatchRealTimeTests : public BaseTest {
+};
+
+/*
+ * The real-time tests mostly sleep, so main() runs them in their own
+ * processes while the rest of the suite runs.
+ */
+LATENCY_BOUND_TESTS("StopwatchRealTimeTests.*:IntegratorRealTimeTests.*");
+
 #define SLEEP_THREAD(_a) std::this_thread::sleep_for(std::chrono::milliseconds(_a))
 #define NANO_PRECISION  10000000
 #define MILLI_PRECISION 20
 #define SEC_PRECISION   0.1
 #define MIN_PRECISION   0.001
+#define REAL_TIME_MS    600
 
 
-TEST_P(StopwatchTests, BasicTest) {
-    int x = GetParam();
-
+void CheckStopwatchBasic(int x) {
     Stopwatch w; // should set the stopwatch to 0 seconds
     w.start();
     SLEEP_THREAD(x);
@@ -339,6 +359,14 @@ TEST_P(StopwatchTests, BasicTest) {
     ASSERT_NEAR(w.get_seconds(), 0.0, SEC_PRECISION); //about 2x
 }
 
+TEST_P(StopwatchTests, BasicTest) {
+    CheckStopwatchBasic(GetParam());
+}
+
+TEST_F(StopwatchRealTimeTests, BasicTest) {
+    CheckStopwatchBasic(REAL_TIME_MS);
+}
+
 //Param A name the test class, Param B good name for what the tests represent
 TEST_P(StopwatchTests, IntermediateTest) {
     int x = GetParam();
@@ -411,6 +439,28 @@ INSTANTIATE_TEST_CASE_P(StopwatchTests,
  * Question 2: Running Average *************************************************
  */
 
+#define SIM_TICK std::chrono::microseconds(10)  // simulated time per clock read
+#define SIM_PERIOD std::chrono::milliseconds(1)  // period the simulated processes are scheduled with
+
+/*
+ * In simulated time every clock read advances a virtual clock by SIM_TICK,
+ * so a run is the same every time. The tests still do not predict how many
+ * updates elma's Manager makes in a run: the generators count their updates
+ * and the time between them, and the expected values are computed from
+ * those counts.
+ */
+
+/*!
+ * Run a Manager for "dur" of simulated time, without sleeping or spinning on
+ * the real clock.
+ * @param m
+ * @param dur
+ */
+void run_simulated(elma::Manager &m, high_resolution_clock::duration dur) {
+    VirtualClock clock(SIM_TICK);
+    m.run(dur);
+}
+
 class RunningAverageTests : public Question2,
                     public testing::WithParamInterface<std::tuple<high_resolution_clock::duration, double, double, double>> {
 };
@@ -432,11 +482,18 @@ class RandomNumGen : public elma::Process {
         }
 
         _sent++;
+        _time += delta();
+        _last_delta = delta();
     }
     void stop() {}
 
+    int sent() { return _sent; }
+    double time() { return _time; }             // ms covered by all the updates
+    double last_delta() { return _last_delta; }  // ms covered by the last update
+
   private:
     int _sent = 0;
+    double _time = 0, _last_delta = 0;
     double _val, _step;
 };
 
@@ -464,11 +521,11 @@ TEST_P(RunningAverageTests, RunningAverage) {
     Filter f("filter");
     elma::Channel link("link");
 
-    m.schedule(r, 1_ms)
-     .schedule(f, 1_ms)
+    m.schedule(r, SIM_PERIOD)
+     .schedule(f, SIM_PERIOD)
      .add_channel(link)
-     .init()
-     .run(dur);
+     .init();
+    run_simulated(m, dur);
 
     ASSERT_NEAR(f.value(), result, DBL_PRECISION);
 };
@@ -484,40 +541,63 @@ INSTANTIATE_TEST_CASE_P(RunningAverageTests,
  */
 
 class IntegratorTests : public Question3,
-                    public testing::WithParamInterface<std::tuple<high_resolution_clock::duration, double, double, double>> {
+                    public testing::WithParamInterface<std::tuple<high_resolution_clock::duration, double, double>> {
 };
 
-std::vector <std::tuple<high_resolution_clock::duration, double, double, double>> intgTestVec =
-    { {100_ms, 0.25, 0.0, 25.0} // dur, base, step, result
-    , {100_ms, 0.5, 0.0, 50.0}
-    , {0_ms, 0.25, 0.0, 0.0}
-    , {150_ms, 0.5, 0.0, 75.0}
-    , {50_ms, 0.25, 0.0, 12.5}
-    , {150_ms, 0, 0.0, 0.0}
-    , {15_ms, 0.25, 0.0, 3.75}
-    , {75_ms, 0.35, 0.0, 26.25}
+std::vector <std::tuple<high_resolution_clock::duration, double, double>> intgTestVec =
+    { {100_ms, 0.25, 0.0} // dur, base, step
+    , {100_ms, 0.5, 0.0}
+    , {0_ms, 0.25, 0.0}
+    , {150_ms, 0.5, 0.0}
+    , {50_ms, 0.25, 0.0}
+    , {150_ms, 0, 0.0}
+    , {15_ms, 0.25, 0.0}
+    , {75_ms, 0.35, 0.0}
     };
 
 //Param A name the test class, Param B good name for what the tests represent
 TEST_P(IntegratorTests, Integrate) {
-    std::tuple<high_resolution_clock::duration, double, double, double> params = GetParam();
+    std::tuple<high_resolution_clock::duration, double, double> params = GetParam();
     high_resolution_clock::duration dur = std::get<0>(params);
     double base = std::get<1>(params);
     double step = std::get<2>(params);
-    double result = std::get<3>(params);
 
     elma::Manager m;
     RandomNumGen r("random numbers", base, step);
     Integrator intg("Integrator");
     elma::Channel link("link");
 
+    m.schedule(r, SIM_PERIOD)
+     .schedule(intg, SIM_PERIOD)
+     .add_channel(link)
+     .init();
+    run_simulated(m, dur);
+
+    // the constant base integrated over the updates the generator saw, with
+    // at most one update of slack for when the integral is added
+    ASSERT_NEAR(intg.value(), base * r.time(), base * r.last_delta() + DBL_PRECISION);
+};
+
+/*
+ * One integration in real time, to check the process also behaves on a real
+ * clock. Like StopwatchRealTimeTests it is outside the question breakdown.
+ */
+class IntegratorRealTimeTests : public BaseTest {
+};
+
+TEST_F(IntegratorRealTimeTests, Integrate) {
+    elma::Manager m;
+    RandomNumGen r("random numbers", 0.25, 0.0);
+    Integrator intg("Integrator");
+    elma::Channel link("link");
+
     m.schedule(r, 1_ms)
      .schedule(intg, 1_ms)
      .add_channel(link)
      .init()
-     .run(dur);
+     .run(100_ms);
 
-    ASSERT_NEAR(intg.value(), result, 1.5);
+    ASSERT_NEAR(intg.value(), 25.0, 1.5);
 };
 
 //Param A random name, Param B test class and Param C list of inputs.
@@ -531,7 +611,7 @@ INSTANTIATE_TEST_CASE_P(IntegratorTests,
  */
 
 class DerivativeTests : public Question4,
-                    public testing::WithParamInterface<std::tuple<high_resolution_clock::duration, double, double, double>> {
+                    public testing::WithParamInterface<std::tuple<high_resolution_clock::duration, double, double>> {
 };
 
 class RandomNumGenDerv : public elma::Process {
@@ -543,44 +623,53 @@ class RandomNumGenDerv : public elma::Process {
     void update() {
         channel("link").send(_val + _step);
         //std::cout << "sending ==> " << _val + _step << "\n";
+        _sent++;
     }
     void stop() {}
 
+    int sent() { return _sent; }
+
   private:
+    int _sent = 0;
     double _val, _step;
 };
 
-std::vector <std::tuple<high_resolution_clock::duration, double, double, double>> dervTestVec =
-    { {100_ms, 250.0, -1.0, -1.0} // dur, base, step, result
-    , {100_ms, 50, -0.5, -0.5}
-    , {0_ms, 0.25, 0.0, 0.0}
-    , {25_ms, 35.0, 1.0, 1.0}
-    , {50_ms, 0.25, 0.0, 0.0}
-    , {150_ms, 3.0, 0.25, 0.25}
-    , {15_ms, -6.0, -0.5, -0.5}
-    , {75_ms, 5.0, 0.75, 0.75}
+std::vector <std::tuple<high_resolution_clock::duration, double, double>> dervTestVec =
+    { {100_ms, 250.0, -1.0} // dur, base, step
+    , {100_ms, 50, -0.5}
+    , {0_ms, 0.25, 0.0}
+    , {25_ms, 35.0, 1.0}
+    , {50_ms, 0.25, 0.0}
+    , {150_ms, 3.0, 0.25}
+    , {15_ms, -6.0, -0.5}
+    , {75_ms, 5.0, 0.75}
     };
 
 //Param A name the test class, Param B good name for what the tests represent
 TEST_P(DerivativeTests, Derivative) {
-    std::tuple<high_resolution_clock::duration, double, double, double> params = GetParam();
+    std::tuple<high_resolution_clock::duration, double, double> params = GetParam();
     high_resolution_clock::duration dur = std::get<0>(params);
     double base = std::get<1>(params);
     double step = std::get<2>(params);
-    double result = std::get<3>(params);
 
     elma::Manager m;
     RandomNumGenDerv r("random numbers", base, step);
     Derivative derv("Derivative");
     elma::Channel link("link");
 
-    m.schedule(r, 1_ms)
-     .schedule(derv, 1_ms)
+    m.schedule(r, SIM_PERIOD)
+     .schedule(derv, SIM_PERIOD)
      .add_channel(link)
-     .init()
-     .run(dur);
-
-    ASSERT_NEAR(derv.value(), result, 1);
+     .init();
+    run_simulated(m, dur);
+
+    // the generator sends the constant base + step, so from the second
+    // update on the derivative is exactly 0
+    if (r.sent() >= 2) {
+        ASSERT_NEAR(derv.value(), 0.0, DBL_PRECISION);
+    } else {
+        ASSERT_NEAR(derv.value(), 0.0, 1);
+    }
 };
 
 //Param A random name, Param B test class and Param C list of inputs.
@@ -0,0 +1,156 @@
+// Virtual time for grading code that reads the system clocks.
+
+#ifndef ECE590_VIRTUAL_CLOCK_H
+#define ECE590_VIRTUAL_CLOCK_H
+
+#include <dlfcn.h>
+#include <time.h>
+#include <sys/time.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+/*
+ * The student's Stopwatch reads std::chrono clocks, which end up in
+ * clock_gettime. Defining clock_gettime (and the sleep calls) here, in the
+ * test executable, interposes them for every caller in the process,
+ * libstdc++ included. While a VirtualClock is alive, time only moves when the
+ * test says so, so a 1500 ms sleep costs nothing and elapsed times are exact.
+ * With no VirtualClock alive, every call is forwarded to the real
+ * implementation.
+ *
+ * Link with -ldl.
+ */
+struct VirtualTime {
+    std::atomic<bool> active;
+    std::atomic<int64_t> elapsed_ns;     // virtual time since the clock was started
+    int64_t tick_ns;                     // advance applied on every clock read, 0 for frozen time
+    int64_t realtime_base_ns;            // CLOCK_REALTIME when the clock was started
+    int64_t monotonic_base_ns;           // CLOCK_MONOTONIC when the clock was started
+};
+
+inline VirtualTime &virtual_time() {
+    static VirtualTime t;
+    return t;
+}
+
+inline int real_clock_gettime(clockid_t id, struct timespec *ts) {
+    typedef int (*clock_gettime_t)(clockid_t, struct timespec *);
+    static clock_gettime_t real = (clock_gettime_t) dlsym(RTLD_NEXT, "clock_gettime");
+    return real(id, ts);
+}
+
+inline int64_t to_ns(const struct timespec &ts) {
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline struct timespec to_timespec(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    return ts;
+}
+
+/*!
+ * Virtual reading of a clock
+ * @param id
+ * @param ns set to the virtual time
+ * @return false if the clock is not virtualized (e.g. CPU time clocks)
+ */
+inline bool virtual_clock_read(clockid_t id, int64_t *ns) {
+    VirtualTime &t = virtual_time();
+    switch (id) {
+        case CLOCK_REALTIME:
+        case CLOCK_REALTIME_COARSE:
+            *ns = t.realtime_base_ns + (t.elapsed_ns += t.tick_ns);
+            return true;
+        case CLOCK_MONOTONIC:
+        case CLOCK_MONOTONIC_RAW:
+        case CLOCK_MONOTONIC_COARSE:
+        case CLOCK_BOOTTIME:
+            *ns = t.monotonic_base_ns + (t.elapsed_ns += t.tick_ns);
+            return true;
+        default:
+            return false;
+    }
+}
+
+extern "C" __attribute__((weak)) int clock_gettime(clockid_t id, struct timespec *ts) {
+    int64_t ns;
+    if (virtual_time().active && virtual_clock_read(id, &ns)) {
+        *ts = to_timespec(ns);
+        return 0;
+    }
+    return real_clock_gettime(id, ts);
+}
+
+extern "C" __attribute__((weak)) int gettimeofday(struct timeval *tv, void *tz) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (tv) {
+        tv->tv_sec = ts.tv_sec;
+        tv->tv_usec = ts.tv_nsec / 1000;
+    }
+    return 0;
+}
+
+extern "C" __attribute__((weak)) int nanosleep(const struct timespec *req, struct timespec *rem) {
+    if (virtual_time().active) {
+        virtual_time().elapsed_ns += to_ns(*req);
+        return 0;
+    }
+    typedef int (*nanosleep_t)(const struct timespec *, struct timespec *);
+    static nanosleep_t real = (nanosleep_t) dlsym(RTLD_NEXT, "nanosleep");
+    return real(req, rem);
+}
+
+extern "C" __attribute__((weak)) int clock_nanosleep(clockid_t id, int flags, const struct timespec *req, struct timespec *rem) {
+    int64_t now;
+    if (virtual_time().active && virtual_clock_read(id, &now)) {
+        int64_t wait = (flags & TIMER_ABSTIME) ? to_ns(*req) - now : to_ns(*req);
+        if (wait > 0) {
+            virtual_time().elapsed_ns += wait;
+        }
+        return 0;
+    }
+    typedef int (*clock_nanosleep_t)(clockid_t, int, const struct timespec *, struct timespec *);
+    static clock_nanosleep_t real = (clock_nanosleep_t) dlsym(RTLD_NEXT, "clock_nanosleep");
+    return real(id, flags, req, rem);
+}
+
+/*
+ * Takes over the process clocks for as long as it is alive.
+ *
+ * By default time is frozen and only moves through sleeps (SLEEP_THREAD) or
+ * advance(). Given a tick, every clock read also advances time by that tick,
+ * so a loop that polls the clock, like elma::Manager::run, steps through
+ * simulated time deterministically and never waits.
+ */
+class VirtualClock {
+public:
+    explicit VirtualClock(std::chrono::nanoseconds tick = std::chrono::nanoseconds(0)) {
+        VirtualTime &t = virtual_time();
+        struct timespec ts;
+        real_clock_gettime(CLOCK_REALTIME, &ts);
+        t.realtime_base_ns = to_ns(ts);
+        real_clock_gettime(CLOCK_MONOTONIC, &ts);
+        t.monotonic_base_ns = to_ns(ts);
+        t.elapsed_ns = 0;
+        t.tick_ns = tick.count();
+        t.active = true;
+    }
+
+    ~VirtualClock() {
+        virtual_time().active = false;
+    }
+
+    void advance(std::chrono::nanoseconds d) {
+        virtual_time().elapsed_ns += d.count();
+    }
+
+    std::chrono::nanoseconds elapsed() const {
+        return std::chrono::nanoseconds(virtual_time().elapsed_ns.load());
+    }
+};
+
+#endif //ECE590_VIRTUAL_CLOCK_H
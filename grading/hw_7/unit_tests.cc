@@ -9,7 +9,11 @@
 #include "betterstatemachine.h"
 #include "robot.h"
 #include "limits.h"
+#include "complexity.h"
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <random>
 
 
 using std::string;
@@ -22,6 +26,15 @@ using nlohmann::json;
 #define DBL_PRECISION 0.0001
 #define Q1POINTS 100.0
 #define Q2POINTS 100.0
+#define ROBOT_EVENTS (1 << 21)          // events sent by RobotThroughputTests
+#define ROBOT_SECONDS 10.0              // stop sending after this long
+#define ROBOT_MIN_EVENTS_PER_SECOND 20000 // lenient floor, the rate itself is reported
+#define FSM_MIN_STATES 1000   // smallest synthetic machine (make TIMING=1), grown 2.5x at a time up to about 100000 states
+#define FSM_STEPS 6
+#define FSM_GROWTH 2.5
+#define FSM_REPEATS 2          // runs per size in the scaling tests
+#define FSM_TOLERANCE 0.6      // allowed growth above the declared class; large machines fall out of cache
+#define FSM_PER_LABEL 8        // transitions sharing each event label
 #define NUM_QUESTIONS 2 // overestimated number of questions
 #define GTEST_COUT_GRADE std::cerr       << "[    GRADE ] "
 
@@ -324,6 +337,85 @@ INSTANTIATE_TEST_CASE_P(RobotTests,
         testing::ValuesIn(robotTestVec)
 );
 
+/*
+ * Reference transitions of the robot, the same as in
+ * BetterStateMachineTests.RobotTest: {state, event, next state}.
+ */
+const char *robotTransitions[][3] = {
+    {"Wander", "battery low", "Find Recharge Station"},
+    {"Wander", "intruder detected", "Make Noise"},
+    {"Find Recharge Station", "found recharge station", "Recharge"},
+    {"Recharge", "battery full", "Wander"},
+    {"Make Noise", "reset", "Wander"},
+    {"Make Noise", "proximity warning", "Evade"},
+    {"Evade", "reset", "Make Noise"},
+    {"Evade", "battery low", "Find Recharge Station"}
+};
+
+class RobotThroughputTests : public Question1 {
+};
+
+/*
+ * Drives the robot through a long pseudo-random walk of valid events and
+ * reports how many events per second it handles. Every state reached is
+ * checked against the reference table. A robot that allocates or compares
+ * strings heavily on each transition shows up in the rate; only a very slow
+ * one fails the floor.
+ */
+TEST_F(RobotThroughputTests, EventsPerSecond) {
+    int n = sizeof(robotTransitions) / sizeof(robotTransitions[0]);
+    vector<string> states;
+    vector<Event> events;
+    vector<vector<int>> out;   // transitions leaving each state
+    vector<int> from(n), to(n);
+    auto index = [](vector<string> &names, const string &name) {
+        auto i = std::find(names.begin(), names.end(), name);
+        if (i == names.end()) {
+            names.push_back(name);
+            return (int) names.size() - 1;
+        }
+        return (int) (i - names.begin());
+    };
+    for (int t = 0; t < n; t++) {
+        from[t] = index(states, robotTransitions[t][0]);
+        to[t] = index(states, robotTransitions[t][2]);
+        out.resize(states.size());
+        out[from[t]].push_back(t);
+        events.push_back(Event(robotTransitions[t][1]));
+    }
+
+    Robot robot("What a very nice robot.");
+    Manager m;
+    m.schedule(robot, 10_ms)
+     .init()
+     .start();
+    ASSERT_EQ(robot.current().name(), "Wander");
+
+    std::mt19937 gen(590);
+    int state = index(states, "Wander"), sent = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    for (; sent < ROBOT_EVENTS && seconds < ROBOT_SECONDS; sent++) {
+        int t = out[state][gen() % out[state].size()];
+        m.emit(events[t]);
+        state = to[t];
+        if (robot.current().name() != states[state]) {
+            FAIL() << "After event " << sent << " (\"" << robotTransitions[t][1] << "\" from "
+                   << robotTransitions[t][0] << ") the robot is in " << robot.current().name()
+                   << ", expected " << states[state];
+        }
+        if (sent % 4096 == 0) {
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double rate = sent / seconds;
+    std::cout << sent << " events in " << seconds << " s: " << rate << " events/s" << std::endl;
+    RecordProperty("events_per_second", (int) rate);
+    EXPECT_GE(rate, ROBOT_MIN_EVENTS_PER_SECOND);
+}
+
 /*
  * Question 2: Better State Machine *************************************************
  */
@@ -414,4 +506,116 @@ TEST_F(BetterStateMachineTests, ToggleSwitch1Test) {
     json j = fsm.to_json();
     ASSERT_EQ(j["name"], "toggle switch 1");
     ASSERT_EQ(j["states"].size(), 4);
-};
\ No newline at end of file
+};
+
+#ifdef GRADE_TIMING
+/*
+ * Large machines *************************************************
+ *
+ * The tests above use machines of up to five states, where a linear search
+ * in add_transition or a quadratic to_json cannot be seen. These tests build
+ * synthetic machines of FSM_MIN_STATES to about 100000 states and check that
+ * adding transitions and to_json take time linear in the size of the
+ * machine, and that dispatching an event does not depend on it beyond the
+ * map lookup elma does. A quadratic implementation runs out of the
+ * complexity budget on the smaller machines and fails there. These are
+ * timed, so they are not part of Question 2 and only built with TIMING=1.
+ */
+
+/*
+ * Machine with n states. State i has two transitions, to i+1 and to a
+ * random state, on two different labels. Labels are reused so that
+ * FSM_PER_LABEL transitions share each one: the elma state machine wakes
+ * every transition watching an event, so this keeps the work per event
+ * constant.
+ */
+struct SyntheticFsm {
+    struct Edge {
+        string event;
+        int from, to;
+    };
+
+    vector<std::unique_ptr<Mode>> modes;
+    vector<Edge> edges;
+    vector<vector<int>> out; // edges leaving each state
+
+    SyntheticFsm(int n, unsigned seed) : out(n) {
+        std::mt19937 gen(seed);
+        int labels = std::max(1, 2 * n / FSM_PER_LABEL);
+        for (int i = 0; i < n; i++) {
+            modes.push_back(std::unique_ptr<Mode>(new Mode("s" + std::to_string(i))));
+        }
+        for (int i = 0; i < n; i++) {
+            int label = (2 * i) % labels;
+            out[i].push_back(edges.size());
+            edges.push_back({"a" + std::to_string(label), i, (i + 1) % n});
+            out[i].push_back(edges.size());
+            edges.push_back({"b" + std::to_string(label + 1), i, (int) (gen() % n)});
+        }
+    }
+
+    BetterStateMachine &build(BetterStateMachine &fsm) {
+        fsm.set_initial(*modes[0])
+           .set_propagate(false);
+        for (const Edge &e : edges) {
+            fsm.add_transition(e.event, *modes[e.from], *modes[e.to]);
+        }
+        return fsm;
+    }
+};
+
+class BetterStateMachineScalingTests : public BaseTest {
+};
+
+TEST_F(BetterStateMachineScalingTests, AddTransitionScales) {
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(FSM_MIN_STATES, FSM_STEPS, FSM_GROWTH), [](int n) {
+        SyntheticFsm synthetic(n, n);
+        BetterStateMachine fsm("synthetic");
+        return elapsed_seconds([&]() { synthetic.build(fsm); });
+    }, FSM_REPEATS, FSM_TOLERANCE);
+};
+
+TEST_F(BetterStateMachineScalingTests, ToJsonScales) {
+    ASSERT_COMPLEXITY(LINEAR, size_ladder(FSM_MIN_STATES, FSM_STEPS, FSM_GROWTH), [](int n) {
+        SyntheticFsm synthetic(n, n);
+        BetterStateMachine fsm("synthetic");
+        synthetic.build(fsm);
+        json j;
+        double t = elapsed_seconds([&]() { j = fsm.to_json(); });
+        EXPECT_EQ(j["states"].size(), n);
+        return t;
+    }, FSM_REPEATS, FSM_TOLERANCE);
+};
+
+/*
+ * Walks n random steps through the machine with Manager::emit, checking the
+ * state reached against the generated transitions. Manager looks up the
+ * watchers of each event in a map, so n events take n log n.
+ */
+TEST_F(BetterStateMachineScalingTests, DispatchScales) {
+    ASSERT_COMPLEXITY(LINEARITHMIC, size_ladder(FSM_MIN_STATES, FSM_STEPS, FSM_GROWTH), [](int n) {
+        SyntheticFsm synthetic(n, n);
+        BetterStateMachine fsm("synthetic");
+        synthetic.build(fsm);
+        Manager m;
+        m.schedule(fsm, 10_ms)
+         .init()
+         .start();
+
+        std::mt19937 gen(n);
+        vector<int> path(n);
+        int state = 0;
+        for (int i = 0; i < n; i++) {
+            path[i] = synthetic.out[state][gen() % 2];
+            state = synthetic.edges[path[i]].to;
+        }
+        double t = elapsed_seconds([&]() {
+            for (int e : path) {
+                m.emit(Event(synthetic.edges[e].event));
+            }
+        });
+        EXPECT_EQ(fsm.current().name(), "s" + std::to_string(state));
+        return t;
+    }, FSM_REPEATS, FSM_TOLERANCE);
+};
+#endif
@@ -0,0 +1,128 @@
+#!/bin/bash
+
+DIR=$PWD                            # current working directory
+PROGRESSDIR="$DIR/results/progress" # written by grade.sh and the test binaries
+INTERVAL=2                          # seconds between refreshes
+ONCE=0                              # if 1, print once and exit
+SLOWEST=5                           # finished students to list
+
+###### OPTIONS ######
+while getopts h:r:n:o: option
+do
+case "${option}"
+in
+h) HWDIR=${OPTARG};;    # homework to watch, by default the latest run
+r) RUNID=${OPTARG};;    # run to watch, by default the latest run of the homework
+n) INTERVAL=${OPTARG};; # seconds between refreshes
+o) ONCE=${OPTARG};;     # if 1, print once and exit
+esac
+done
+shift $((OPTIND -1))
+
+function usage() {
+    echo "Usage:"
+    echo "-h   Which homework to watch (optional, default the latest grade.sh run)"
+    echo "-r   Which run of the homework to watch, see grade.sh -r (optional, default the latest)"
+    echo "-n   Seconds between refreshes (optional, default $INTERVAL)"
+    echo "-o   If 1, print the progress once and exit (optional)"
+}
+
+if ! [[ $HWDIR ]];
+then
+    HWDIR="$(ls -t $PROGRESSDIR 2> /dev/null | head -n 1)"
+fi
+RUNDIR="$(ls -t $PROGRESSDIR/$HWDIR 2> /dev/null | head -n 1)"
+if [[ $RUNID ]];
+then
+    # grade.sh writes each run to <HW>/<run>-<pid>, the run name with anything
+    # but letters, digits, '.', '_' and '-' replaced by '_'
+    RUNNAME="${RUNID//[^A-Za-z0-9._-]/_}"
+    RUNDIR="$(ls -t $PROGRESSDIR/$HWDIR 2> /dev/null | grep -x "${RUNNAME//./\\.}-[0-9]*" | head -n 1)"
+fi
+RUNDIR="$PROGRESSDIR/$HWDIR/$RUNDIR"
+if ! [[ $HWDIR && -e $RUNDIR/run.events ]];
+then
+    echo "OPPS! No grading run found in $PROGRESSDIR."
+    usage
+    exit 1
+fi
+
+# Reads run.events, then the test events of each student, and prints the
+# students per minute, the ETA, the running jobs (slowest first) and the
+# slowest finished students.
+function show() {
+    cd $RUNDIR
+    awk -F'\t' -v now="$(date +%s)" -v slowest=$SLOWEST '
+    function duration(s) {
+        s = int(s)
+        return s >= 3600 ? sprintf("%dh%02dm", s / 3600, (s % 3600) / 60) : sprintf("%dm%02ds", s / 60, s % 60)
+    }
+    FILENAME == "run.events" {
+        if ($2 == "run_start") { run = $3; total = $4; started = $1 }
+        else if ($2 == "student_start") { start[$3] = $1; phase[$3] = "checkout"; running[$3] = 1 }
+        else if ($2 == "phase") { phase[$3] = $4 }
+        else if ($2 == "student_end") { delete running[$3]; done++; took[$3] = $1 - start[$3]; grade[$3] = $4 }
+        else if ($2 == "run_end") { ended = $1 }
+        next
+    }
+    {
+        login = FILENAME
+        sub(/\.events$/, "", login)
+        if ($2 == "tests") { tests[login] += $3 }
+        else if ($2 == "test_start") { current[login] = $3; current_start[login] = $1 }
+        else if ($2 == "test_end") { finished[login]++; if ($4 == "0") failed[login]++; if (current[login] == $3) current[login] = "" }
+    }
+    END {
+        elapsed = (ended ? ended : now) - started
+        rate = elapsed > 0 ? done / (elapsed / 60) : 0
+        printf "%s run %s: %d/%d students done in %s, %.1f students/min", HWDIR, run, done, total, duration(elapsed), rate
+        if (ended) { printf ", finished\n" }
+        else if (rate > 0) { printf ", ETA %s\n", duration((total - done) / rate * 60) }
+        else { printf "\n" }
+
+        printf "\n%-20s %-8s %-9s %-10s %-7s %s\n", "RUNNING", "PHASE", "ELAPSED", "TESTS", "FAILED", "CURRENT TEST"
+        n = 0
+        for (login in running) { order[++n] = login }
+        for (i = 2; i <= n; i++) {     # slowest first
+            for (j = i; j > 1 && start[order[j]] < start[order[j - 1]]; j--) {
+                t = order[j]; order[j] = order[j - 1]; order[j - 1] = t
+            }
+        }
+        for (i = 1; i <= n; i++) {
+            login = order[i]
+            progress = tests[login] ? sprintf("%d/%d", finished[login], tests[login]) : ""
+            test = current[login] ? sprintf("%s (%s)", current[login], duration(now - current_start[login])) : ""
+            printf "%-20s %-8s %-9s %-10s %-7s %s\n", login, phase[login], duration(now - start[login]), progress,
+                   failed[login] + 0, test
+        }
+
+        printf "\n%-20s %-9s %s\n", "SLOWEST FINISHED", "TOOK", "GRADE"
+        m = 0
+        for (login in took) { slow[++m] = login }
+        for (i = 2; i <= m; i++) {
+            for (j = i; j > 1 && took[slow[j]] > took[slow[j - 1]]; j--) {
+                t = slow[j]; slow[j] = slow[j - 1]; slow[j - 1] = t
+            }
+        }
+        for (i = 1; i <= m && i <= slowest; i++) {
+            printf "%-20s %-9s %s\n", slow[i], duration(took[slow[i]]), grade[slow[i]]
+        }
+    }' HWDIR=$HWDIR run.events $(ls *.events | grep -v '^run.events$')
+    cd $DIR
+}
+
+if [[ $ONCE == 1 ]];
+then
+    show
+    exit 0
+fi
+while true;
+do
+    clear
+    show
+    if grep -q "run_end" $RUNDIR/run.events;
+    then
+        break
+    fi
+    sleep $INTERVAL
+done
@@ -7,6 +7,19 @@ CLASSREPO="EEP520-W20"
 DIR=$PWD                    # current working directory
 RESULTS="$DIR/results"      # output directory for results
 DUEDATE=""           # the due date of the homework
+JOBS=1                      # number of repos pulled at once
+RETRIES=3                   # attempts per repo before giving up
+BACKOFF=2                   # seconds to wait after the first failed attempt, doubled after each retry
+PULLLOG="$RESULTS/pull"     # per student pull logs and status
+REMOTE="https://github.com" # where student and class repos are cloned from
+SPARSE=0                    # if 1, clone student repos without blobs and check out only HWDIR
+REFERENCE=0                 # if 1, clone student repos against a shared object store
+REFERENCEDIR="$DIR/$STUDENTDIR/.reference.git" # the shared object store
+REFERENCEREPOS="klavins/$CLASSREPO" # repos whose objects are shared by the student repos
+BUNDLEDIR=""                # if set, pull from git bundles in this directory instead of the network
+MIRRORDIR=""                # if set, pull from bare repos <owner>/<repo>.git in this directory
+CHECKREMOTE=0               # if 1, compare remote branches with ls-remote and only fetch repos that moved
+CHANGED="$PULLLOG/changed.csv" # students whose repos got new commits, in the format of the input csv
 
 MAKE="MakefileGrade$TESTVER"        # name of the makefile to use for compiling
 
@@ -14,55 +27,245 @@ SUMMARY="$RESULTS/summary.csv"
 GRADEPATTERN="HOMEWORK_GRADE:" # pattern to look for from main.c to build the summary
 
 ###### OPTIONS ######
-while getopts i:l:d: option
+while getopts i:h:l:d:j:r:s:R:b:m:c: option
 do
 case "${option}"
 in
 i) input=${OPTARG};;  # the input file for student logins
+h) HWDIR=${OPTARG};;  # this weeks homework directory name, needed with -s 1
 l) login=${OPTARG};;  # optionally provide a single login to evalute just one student
 d) DUEDATE=${OPTARG};; # due date for the homework
+j) JOBS=${OPTARG};;   # number of repos pulled at once
+r) RETRIES=${OPTARG};; # attempts per repo
+s) SPARSE=${OPTARG};; # if 1, sparse partial clones of HWDIR only
+R) REFERENCE=${OPTARG};; # if 1, share objects through $REFERENCEDIR
+b) BUNDLEDIR=${OPTARG};; # offline, pull from <login>.bundle files
+m) MIRRORDIR=${OPTARG};; # offline, pull from a directory of bare repos
+c) CHECKREMOTE=${OPTARG};; # if 1, skip fetching repos whose remote has not changed
 esac
 done
 shift $((OPTIND -1))
 
 function usage() {
     echo "Usage:"
+    echo "-h   Which homework you are pulling (e.g. 'HW_1'), required with -s 1"
     echo "-l   Student's github login (optional)"
     echo "-i   Filepath of csv of all students [LAST_NAME,FIRST_NAME,GITHUB_LOGIN]"
     echo "-d   The due date for the assignment e.g. '2019-01-21'"
+    echo "-j   Number of repos to pull at once (optional, default 1)"
+    echo "-r   Attempts per repo before giving up (optional, default 3)"
+    echo "-s   If 1, fetch only the commits and the files under the homework directory at the due date (optional)"
+    echo "-R   If 1, clone student repos against the shared object store $REFERENCEDIR (optional)"
+    echo "-b   Offline: pull from the bundles <login>.bundle, <login>.1.bundle, ... in this directory (optional)"
+    echo "-m   Offline: pull from the bare repos <login>/$STUDENTREPO.git in this directory (optional)"
+    echo "-c   If 1, only fetch repos whose branches moved on the remote (optional)"
 }
 
+if [[ $SPARSE == 1 && ! $HWDIR ]];
+then
+    echo "OPPS! Sparse clones need the homework directory. Please add the '-h' argument."
+    usage
+    exit 1
+fi
+
+if [[ $BUNDLEDIR && $MIRRORDIR ]];
+then
+    echo "OPPS! Use either '-b' or '-m', not both."
+    usage
+    exit 1
+fi
+if [[ $BUNDLEDIR ]];
+then
+    BUNDLEDIR="$(cd $BUNDLEDIR && pwd)" || exit 1
+    RETRIES=1
+fi
+if [[ $MIRRORDIR ]];
+then
+    MIRRORDIR="$(cd $MIRRORDIR && pwd)" || exit 1
+    REMOTE="file://$MIRRORDIR"
+    RETRIES=1
+fi
+
 ###### FUNCTIONS ######
+# Creates the shared object store and fetches the repos in $REFERENCEREPOS
+# into it. Student clones point at it, so objects are only ever added: it is
+# never pruned or garbage collected.
+function update_reference () {
+    echo ""
+    echo "Updating shared object store '$REFERENCEDIR'"
+    if ! [[ -d $REFERENCEDIR ]];
+    then
+        mkdir -p $STUDENTDIR
+        git init --bare -q $REFERENCEDIR
+        git -C $REFERENCEDIR config gc.auto 0
+    fi
+    for repo in $REFERENCEREPOS;
+    do
+        git -C $REFERENCEDIR fetch -q "$REMOTE/$repo" "+refs/heads/*:refs/reference/$repo/*"
+        if [[ $? -eq 0 ]];
+        then
+            echo "INFO: Fetched '$repo' into the shared object store"
+        else
+            echo "ERROR: Failed to fetch '$repo' into the shared object store"
+        fi
+    done
+}
+
+# prefetch_homework <directory> <repo> <sparse directory>
+# A partial clone downloads the files of an old commit only when they are
+# first read, which for grade.sh is the 'git worktree add' of the last commit
+# before the due date, offline or not. Fetches them now, in one batch: the
+# files under <sparse directory> and at the top of the repo, as cone mode
+# checks them out.
+function prefetch_homework () {
+    commit="$(git -C $1 rev-list master -n 1 --first-parent ${DUEDATE:+--before=$DUEDATE} --date=local)"
+    [[ $commit ]] || return 0
+    missing="$(git -C $1 rev-list --objects --missing=print $commit -- $3 ':(glob)*' | sed -n 's/^?//p')"
+    [[ $missing ]] || return 0
+    echo "INFO: Fetching $(echo "$missing" | wc -l) file(s) of commit $commit"
+    echo "$missing" | git -C $1 -c fetch.negotiationAlgorithm=noop fetch -q --no-tags --no-write-fetch-head \
+        --recurse-submodules=no --filter=blob:none --stdin "$REMOTE/$2"
+}
+
+# pull_repo <directory> <repo> [<sparse directory>]
 function pull_repo () {
     directory=$1
     repo=$2
+    sparsedir=$3
     echo ""
     echo "Pulling repo '$1'"
 
-    if [[ -e $1 ]];
-    then
-        echo "INFO: '$directory' already exists. Attempting to fetch and prune..."
-        PREVDIR=$PWD
-        cd $1
-        git fetch origin --prune #> git.log 2>&1
-        success=$?
-        if [[ $success -eq 0 ]];
+    attempt=1
+    delay=$BACKOFF
+    while true;
+    do
+        if [[ -e $1 ]];
         then
-            echo "INFO: Successfully fetched and pruned the repo"
+            echo "INFO: '$directory' already exists. Attempting to fetch and prune..."
+            PREVDIR=$PWD
+            cd $1
+            if [[ $CHECKREMOTE == 1 ]] && remote_unchanged $repo;
+            then
+                echo "INFO: No new commits on the remote, skipping fetch"
+                true
+            elif [[ $MIRRORDIR ]];
+            then
+                # existing clones point at github; fetch from the mirror instead
+                git fetch --prune "$REMOTE/$repo" "+refs/heads/*:refs/remotes/origin/*"
+            else
+                git fetch origin --prune #> git.log 2>&1
+            fi
+            success=$?
+            if [[ $success -eq 0 && $sparsedir && "$(git config core.sparseCheckout)" == "true" ]];
+            then
+                # only this week's homework stays checked out
+                git sparse-checkout set $sparsedir && prefetch_homework . $repo $sparsedir
+                success=$?
+            fi
+            if [[ $success -eq 0 ]];
+            then
+                echo "INFO: Successfully fetched and pruned the repo"
+            else
+                echo "ERROR: There was an error trying to fetch the repo"
+            fi
+            cd $PREVDIR
         else
-            echo "ERROR: There was an error trying to fetch the repo"
+            echo "INFO: '$directory' does not exist. Attempting clone repo..."
+            cloneflags=""
+            if [[ $REFERENCE == 1 && -d $REFERENCEDIR ]];
+            then
+                # objects already in the reference are borrowed through .git/objects/info/alternates
+                cloneflags="--reference $REFERENCEDIR"
+            fi
+            if [[ $sparsedir ]];
+            then
+                # every commit, so the due date can be resolved, but only the blobs under $sparsedir
+                git clone $cloneflags --filter=blob:none --sparse --no-checkout "$REMOTE/$repo" $directory &&
+                    git -C $directory sparse-checkout set $sparsedir &&
+                    git -C $directory checkout &&
+                    prefetch_homework $directory $repo $sparsedir
+            else
+                git clone $cloneflags "$REMOTE/$repo" $directory # > git.log 2>&1
+            fi
+            success=$?
+            if [[ $success -eq 0 ]];
+            then
+                echo "INFO: Repo '$repo' successfully cloned"
+            else
+                echo "ERROR: Failed to pull repo '$repo'"
+            fi
         fi
-        cd $PREVDIR
-    else
-        echo "INFO: '$directory' does not exist. Attempting clone repo..."
-        git clone "https://github.com/$repo" $directory # > git.log 2>&1
-        success=$?
-        if [[ $success -eq 0 ]];
+
+        if [[ $success -eq 0 || $attempt -ge $RETRIES ]];
         then
-            echo "INFO: Repo '$repo' successfully cloned"
-        else
-            echo "ERROR: Failed to pull repo '$repo'"
+            break
         fi
+        echo "INFO: Attempt $attempt of $RETRIES failed, retrying in $delay seconds..."
+        sleep $delay
+        attempt=$((attempt + 1))
+        delay=$((delay * 2))
+    done
+    return $success
+}
+
+# The branches of the current repo as of its last fetch, one "<sha> refs/heads/<branch>" per line
+function fetched_refs () {
+    git for-each-ref --format='%(objectname) %(refname)' refs/remotes/origin 2> /dev/null |
+        grep -v '/HEAD$' | sed 's# refs/remotes/origin/# refs/heads/#' | sort
+}
+
+# remote_unchanged <repo>
+# True when the branches of <repo> are where the last fetch left them. Costs
+# one ls-remote, much less than a fetch when there are many repos to check.
+function remote_unchanged () {
+    remoterefs="$(git ls-remote --heads "$REMOTE/$1" | tr '\t' ' ' | sort)"
+    [[ $remoterefs && "$remoterefs" == "$(fetched_refs)" ]]
+}
+
+# pull_bundles <directory> <name> <repo>
+# Fetches <name>.bundle and then <name>.1.bundle, <name>.2.bundle, ... from
+# $BUNDLEDIR into the repo, as 'git fetch' would from origin. Bundles that
+# were fetched before change nothing, so newer incremental bundles can just
+# be added to the directory.
+function pull_bundles () {
+    directory=$1
+    name=$2
+    repo=$3
+    echo ""
+    echo "Pulling bundles '$BUNDLEDIR/$name*.bundle' into '$directory'"
+
+    attempt=1
+    # incremental bundles in the order of their number, whatever dots are in the path
+    bundles="$(ls $BUNDLEDIR/$name.bundle 2> /dev/null; ls $BUNDLEDIR/$name.*.bundle 2> /dev/null \
+               | sed -n 's/.*\.\([0-9][0-9]*\)\.bundle$/\1 &/p' | sort -n | cut -d' ' -f2-)"
+    if ! [[ $bundles ]];
+    then
+        echo "ERROR: No bundle found for '$name'"
+        return 1
+    fi
+
+    new=0
+    if ! [[ -e $directory ]];
+    then
+        echo "INFO: '$directory' does not exist. Creating it from the bundles..."
+        git init -q $directory
+        git -C $directory remote add origin "$REMOTE/$repo"
+        new=1
+    fi
+    for bundle in $bundles;
+    do
+        git -C $directory fetch -q "$bundle" "+refs/heads/*:refs/remotes/origin/*"
+        if [[ $? -ne 0 ]];
+        then
+            echo "ERROR: Failed to fetch '$bundle'"
+            return 1
+        fi
+        echo "INFO: Fetched '$bundle'"
+    done
+    if [[ $new -eq 1 ]];
+    then
+        # what a clone would have checked out
+        git -C $directory checkout -q -b master origin/master
     fi
 }
 
@@ -85,19 +288,85 @@ function evaluate() {
   echo "Github  : ${login}"
   echo "\nPULL:"
 
-  pull_repo $STUDENTDIR/$login $login/$STUDENTREPO
+  start=$SECONDS
+  before="$(cd $STUDENTDIR/$login 2> /dev/null && fetched_refs)"
+  if [[ $BUNDLEDIR ]];
+  then
+    pull_bundles $STUDENTDIR/$login $login $login/$STUDENTREPO
+  elif [[ $SPARSE == 1 ]];
+  then
+    pull_repo $STUDENTDIR/$login $login/$STUDENTREPO $HWDIR
+  else
+    pull_repo $STUDENTDIR/$login $login/$STUDENTREPO
+  fi
+  if [[ $? -eq 0 ]];
+  then
+    status="OK"
+    if [[ "$before" == "$(cd $STUDENTDIR/$login && fetched_refs)" ]];
+    then
+      status="UNCHANGED"
+    else
+      echo "$fname,$lname,$login" > $PULLLOG/$login.changed
+    fi
+  else
+    status="FAILED"
+  fi
+  echo "$login,$status,$attempt,$((SECONDS - start))" > $PULLLOG/$login.status
+}
+
+# runs evaluate for one student, in the background when pulling several repos at once
+function schedule() {
+  mkdir -p $PULLLOG
+  if [[ $JOBS -gt 1 ]];
+  then
+    # wait for a free slot; 'wait -n' needs bash 4.3, older shells poll
+    while [[ $(jobs -rp | wc -l) -ge $JOBS ]];
+    do
+      wait -n 2> /dev/null || sleep 1
+    done
+    evaluate $1 $2 $3 < /dev/null > $PULLLOG/$3.log 2>&1 &
+  else
+    evaluate $1 $2 $3 2>&1 | tee $PULLLOG/$3.log
+  fi
+}
+
+function status_table() {
+  printf "%-24s %-10s %-9s %s\n" "LOGIN" "STATUS" "ATTEMPTS" "SECONDS"
+  sort $PULLLOG/*.status | tee $PULLLOG/status.csv | while IFS=',' read login status attempts seconds
+  do
+    printf "%-24s %-10s %-9s %s\n" "$login" "$status" "$attempts" "$seconds"
+  done
+  failed="$(grep -c ",FAILED," $PULLLOG/status.csv)"
+  [[ $failed -gt 0 ]] && echo "$failed repo(s) failed, see $PULLLOG/<login>.log"
+  cat $PULLLOG/*.changed > $CHANGED 2> /dev/null
+  echo "$(cat $CHANGED | wc -l) repo(s) changed, grade them with: sh grade.sh -i $CHANGED -h <HW>"
 }
 
 ###### SETUP ######
 echo "***** SETUP *****"
 mkdir -p $RESULTS
-pull_repo $CLASSDIR "klavins/$CLASSREPO"
+if [[ $BUNDLEDIR ]];
+then
+    pull_bundles $CLASSDIR $CLASSREPO "klavins/$CLASSREPO"
+else
+    pull_repo $CLASSDIR "klavins/$CLASSREPO"
+fi
+if [[ $REFERENCE == 1 && ! $BUNDLEDIR ]];
+then
+    update_reference
+fi
 echo "***** END SETUP *****"
 echo ""
 
 
 ###### PULL ######
 echo "***** BEGIN PULL *****"
+if [[ $JOBS -gt 1 ]];
+then
+    # concurrent pulls cannot share the terminal for credential prompts
+    export GIT_TERMINAL_PROMPT=0
+fi
+rm -f $PULLLOG/*.status $PULLLOG/*.changed
 if [[ $APPEND == 1 ]];
 then
     [[ -e $STUDENTDIR ]] && rm -rf $STUDENTDIR
@@ -110,11 +379,13 @@ then
     while IFS=',' read fname lname login
     do
       echo "Login $login"
-      evaluate $lname $fname $login
+      schedule $lname $fname $login
     done < "$input"
 else
     echo "Using single login '$login'"
-    evaluate "unknown" "unknown" $login
+    schedule "unknown" "unknown" $login
 fi
+wait
+status_table
 
 echo "***** END PULL *****"
@@ -0,0 +1,112 @@
+#!/bin/bash
+
+DIR=$PWD                            # current working directory
+RESULTS="$DIR/results"              # output directory for results
+RESULTSDB="$RESULTS/results.db"     # written by grade.sh
+DBTIMEOUT=10000                     # ms to wait while a grade.sh run is writing
+
+function usage() {
+    echo "Usage: sh results.sh <command> [arguments]"
+    echo ""
+    echo "runs                      List the grading runs"
+    echo "grades <HW> [run]         Grade of every student, from the latest run by default"
+    echo "failing <HW> [run]        Tests by the number of students failing them"
+    echo "student <HW> <login> [run] Failed tests of one student, from their latest run by default"
+    echo "diff-runs <HW> <old> [new] Students whose grade changed and tests that flipped between two runs"
+    echo "sql '<query>'             Any query, e.g. sh results.sh sql 'SELECT count(*) FROM tests'"
+}
+
+if ! [[ -e $RESULTSDB ]];
+then
+    echo "OPPS! No results database at $RESULTSDB. Run grade.sh first."
+    exit 1
+fi
+
+# quotes a string for sql
+function sql_quote() {
+    printf "'%s'" "${1//\'/\'\'}"
+}
+
+# run_of <HW> [run] [login]
+# The given run, or else the latest run of the homework that graded the
+# student, or any latest run of the homework
+function run_of() {
+    if [[ $2 ]];
+    then
+        sql_quote "$2"
+    elif [[ $3 ]];
+    then
+        echo "(SELECT g.run FROM grades g JOIN runs r ON r.run = g.run AND r.homework = g.homework
+               WHERE g.homework = $(sql_quote "$1") AND g.login = $(sql_quote "$3") ORDER BY r.rowid DESC LIMIT 1)"
+    else
+        echo "(SELECT run FROM runs WHERE homework = $(sql_quote "$1") ORDER BY rowid DESC LIMIT 1)"
+    fi
+}
+
+function query() {
+    sqlite3 -header -column -cmd ".timeout $DBTIMEOUT" $RESULTSDB "$1"
+}
+
+command=$1
+shift
+case "$command"
+in
+runs)
+    query "SELECT r.run, r.homework, r.duedate, r.started, r.flags, count(g.login) AS students
+           FROM runs r LEFT JOIN grades g ON g.run = r.run AND g.homework = r.homework
+           GROUP BY r.run, r.homework ORDER BY r.rowid;"
+    ;;
+grades)
+    query "SELECT login, fname, lname, passed, total, failure FROM grades
+           WHERE homework = $(sql_quote "$1") AND run = $(run_of "$1" "$2") ORDER BY login;"
+    ;;
+failing)
+    query "SELECT test, sum(passed = 0) AS failed, count(*) AS students FROM tests
+           WHERE homework = $(sql_quote "$1") AND run = $(run_of "$1" "$2")
+           GROUP BY test HAVING failed > 0 ORDER BY failed DESC, test;"
+    ;;
+student)
+    query "SELECT test, ms FROM tests
+           WHERE homework = $(sql_quote "$1") AND login = $(sql_quote "$2") AND run = $(run_of "$1" "$3" "$2") AND passed = 0
+           ORDER BY test;"
+    ;;
+diff-runs)
+    if ! [[ $2 ]];
+    then
+        usage
+        exit 1
+    fi
+    hw="$(sql_quote "$1")"
+    old="$(sql_quote "$2")"
+    new="$(run_of "$1" "$3")"
+    # only students whose digests differ are compared test by test
+    query "CREATE TEMP TABLE changed AS
+               SELECT n.login AS login, o.passed || '/' || o.total AS old, n.passed || '/' || n.total AS new
+               FROM grades n LEFT JOIN grades o ON o.run = $old AND o.homework = n.homework AND o.login = n.login
+               WHERE n.run = $new AND n.homework = $hw
+                   AND (o.digest IS NULL OR n.digest IS NULL OR o.digest != n.digest
+                        OR o.passed IS NOT n.passed OR o.total IS NOT n.total)
+               UNION ALL
+               SELECT o.login, o.passed || '/' || o.total, NULL FROM grades o
+               WHERE o.run = $old AND o.homework = $hw
+                   AND NOT EXISTS (SELECT 1 FROM grades n WHERE n.run = $new AND n.homework = $hw AND n.login = o.login);
+           SELECT login, old AS old_grade, new AS new_grade FROM changed WHERE old IS NOT new ORDER BY login;
+           SELECT c.login, n.test, o.passed AS old_passed, n.passed AS new_passed
+               FROM changed c JOIN tests n ON n.run = $new AND n.homework = $hw AND n.login = c.login
+               LEFT JOIN tests o ON o.run = $old AND o.homework = $hw AND o.login = c.login AND o.test = n.test
+               WHERE o.passed IS NOT n.passed
+           UNION ALL
+           SELECT c.login, o.test, o.passed, NULL
+               FROM changed c JOIN tests o ON o.run = $old AND o.homework = $hw AND o.login = c.login
+               WHERE NOT EXISTS (SELECT 1 FROM tests n WHERE n.run = $new AND n.homework = $hw
+                                 AND n.login = c.login AND n.test = o.test)
+           ORDER BY 1, 2;"
+    ;;
+sql)
+    query "$1"
+    ;;
+*)
+    usage
+    exit 1
+    ;;
+esac
@@ -0,0 +1,248 @@
+// Compact grading logs and expand them back.
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define POINTS_PREFIX "POINTS: "
+#define RUN_PREFIX "[ RUN      ] "
+#define OK_PREFIX "[       OK ] "
+#define COMPACT_OK "@OK "   // a passing test whose output is the same as the previous one's
+#define COMPACT_START "@START" // first line of every compact stream
+#define COMPACT_NOEOL "@NOEOL" // last line of a stream whose input did not end with a newline
+#define COMPACT_ESCAPE '@'  // doubled at the start of any other line starting with it
+
+/*
+ * Most of a grading log is the same few lines around every passing test,
+ *
+ *     POINTS: 41
+ *     [ RUN      ] SortTests/SortTests.SortByMag/3
+ *     100
+ *     Question breakdown:
+ *     [ 100 0 0 0 100 ]
+ *     [       OK ] SortTests/SortTests.SortByMag/3 (0 ms)
+ *
+ * "compact_log compact" replaces each passing test whose output (the lines
+ * between RUN and OK) is the same as that of the previous passing test with
+ *
+ *     @OK 41 0 SortTests/SortTests.SortByMag/3
+ *
+ * holding the points, milliseconds and name. The header, the first passing
+ * test, every test whose output changed (so the breakdown whenever it
+ * changes) and all failures are kept in full. "compact_log expand" gives
+ * back the original log exactly. Both read stdin and write stdout line by
+ * line, so grade.sh streams the log through gzip as the tests run.
+ *
+ * grade.sh runs one compactor per append to the log, so a compact log is a
+ * series of streams. Each starts with COMPACT_START, on which the expander
+ * forgets the previous test as the new compactor never saw it, and ends with
+ * COMPACT_NOEOL if its input did not end with a newline.
+ */
+
+/*!
+ * A passing test: "POINTS: <points>", "[ RUN      ] <name>", body, "[       OK ] <name> (<ms> ms)"
+ */
+struct Passed {
+    string points, name, ms;
+    vector<string> body;
+
+    vector<string> lines(const vector<string> &body) const {
+        vector<string> all;
+        all.push_back(POINTS_PREFIX + points);
+        all.push_back(RUN_PREFIX + name);
+        all.insert(all.end(), body.begin(), body.end());
+        all.push_back(OK_PREFIX + name + " (" + ms + " ms)");
+        return all;
+    }
+};
+
+bool starts_with(const string &s, const string &prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool is_number(const string &s) {
+    return !s.empty() && s.find_first_not_of("0123456789") == string::npos;
+}
+
+/*
+ * Splits a log into passing tests and other lines. Both directions parse the
+ * full log with it, so they agree on which output the next @OK repeats.
+ */
+class LogParser {
+public:
+    virtual ~LogParser() {}
+
+    void line(const string &l) {
+        if (_pending.empty()) {
+            if (starts_with(l, POINTS_PREFIX) && is_number(l.substr(sizeof(POINTS_PREFIX) - 1))) {
+                _pending.push_back(l);
+            } else {
+                other(l);
+            }
+            return;
+        }
+        if (_pending.size() == 1) {
+            if (starts_with(l, RUN_PREFIX)) {
+                _pending.push_back(l);
+            } else {
+                flush();
+                line(l);
+            }
+            return;
+        }
+        string name = _pending[1].substr(sizeof(RUN_PREFIX) - 1);
+        string ok = OK_PREFIX + name + " (";
+        if (starts_with(l, ok) && l.size() > ok.size() + 4 && l.compare(l.size() - 4, 4, " ms)") == 0
+            && is_number(l.substr(ok.size(), l.size() - ok.size() - 4))) {
+            Passed p;
+            p.points = _pending[0].substr(sizeof(POINTS_PREFIX) - 1);
+            p.name = name;
+            p.ms = l.substr(ok.size(), l.size() - ok.size() - 4);
+            p.body.assign(_pending.begin() + 2, _pending.end());
+            _pending.clear();
+            passed(p);
+        } else if (starts_with(l, POINTS_PREFIX) || starts_with(l, RUN_PREFIX)) {
+            // the test did not finish
+            flush();
+            line(l);
+        } else {
+            _pending.push_back(l);
+        }
+    }
+
+    void flush() {
+        for (const string &l : _pending) {
+            other(l);
+        }
+        _pending.clear();
+    }
+
+protected:
+    vector<string> _previous; // body of the last passing test
+    virtual void passed(const Passed &p) = 0;
+    virtual void other(const string &l) = 0;
+
+private:
+    vector<string> _pending;
+};
+
+class Compactor : public LogParser {
+public:
+    Compactor() {
+        std::cout << COMPACT_START << "\n";
+    }
+
+protected:
+    void passed(const Passed &p) {
+        if (p.body == _previous) {
+            std::cout << COMPACT_OK << p.points << " " << p.ms << " " << p.name << "\n";
+        } else {
+            for (const string &l : p.lines(p.body)) {
+                other(l);
+            }
+            _previous = p.body;
+        }
+    }
+
+    void other(const string &l) {
+        if (!l.empty() && l[0] == COMPACT_ESCAPE) {
+            std::cout << COMPACT_ESCAPE;
+        }
+        std::cout << l << "\n";
+    }
+};
+
+class Expander : public LogParser {
+public:
+    /*!
+     * A line of the compact log
+     */
+    void compact_line(const string &l) {
+        if (starts_with(l, COMPACT_OK)) {
+            flush();
+            Passed p;
+            size_t a = sizeof(COMPACT_OK) - 1, b = l.find(' ', a), c = l.find(' ', b + 1);
+            p.points = l.substr(a, b - a);
+            p.ms = l.substr(b + 1, c - b - 1);
+            p.name = l.substr(c + 1);
+            for (const string &out : p.lines(_previous)) {
+                other(out);
+            }
+        } else if (l == COMPACT_START) {
+            flush();
+            _previous.clear();
+        } else if (l == COMPACT_NOEOL) {
+            flush();
+            _newline = false;
+        } else if (!l.empty() && l[0] == COMPACT_ESCAPE) {
+            line(l.substr(1));
+        } else {
+            line(l);
+        }
+    }
+
+    /*!
+     * Ends the log, with the newline of the last line unless it had none
+     */
+    void finish() {
+        flush();
+        if (_newline) {
+            std::cout << "\n";
+        }
+        _newline = false;
+    }
+
+protected:
+    void passed(const Passed &p) {
+        for (const string &l : p.lines(p.body)) {
+            other(l);
+        }
+        _previous = p.body;
+    }
+
+    // the newline of each line is written with the next one, so COMPACT_NOEOL can drop it
+    void other(const string &l) {
+        if (_newline) {
+            std::cout << "\n";
+        }
+        std::cout << l;
+        _newline = true;
+    }
+
+private:
+    bool _newline = false; // the last line written still needs its newline
+};
+
+int main(int argc, char **argv) {
+    string mode = argc > 1 ? argv[1] : "";
+    std::ios::sync_with_stdio(false);
+    string l;
+    if (mode == "compact") {
+        Compactor compactor;
+        bool newline = true;
+        while (std::getline(std::cin, l)) {
+            newline = !std::cin.eof();
+            compactor.line(l);
+        }
+        compactor.flush();
+        if (!newline) {
+            std::cout << COMPACT_NOEOL << "\n";
+        }
+    } else if (mode == "expand") {
+        Expander expander;
+        while (std::getline(std::cin, l)) {
+            expander.compact_line(l);
+        }
+        expander.finish();
+    } else {
+        std::cout << "Usage:" << std::endl
+                  << "compact_log compact < log > compact_log" << std::endl
+                  << "compact_log expand < compact_log > log" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+// Student x test outcome matrix of a homework.
+
+#include <dirent.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define MATRIX_FILE "outcomes.matrix"  // written next to the results of the homework
+#define MATRIX_MAGIC "OUTCOMES 1"
+#define RESULTS_EXT ".tsv"             // per student results copied there by grade.sh
+
+/*
+ * grade.sh leaves the results of every test of every student in
+ * results/<HW>/<login>.tsv. This tool packs them into a matrix with one row
+ * per student and one bit per test, set when the test failed or did not run,
+ *
+ *     outcome_matrix build results/HW_5
+ *
+ * and saves it as results/<HW>/outcomes.matrix: a text header with the test
+ * names (the column dictionary) and the logins, followed by the rows as
+ * 64 bit words. Questions about the whole class are then a few word
+ * operations per student:
+ *
+ *     outcome_matrix failing results/HW_5 'MatrixMult*'  students failing any matching test
+ *     outcome_matrix same results/HW_5                  tests failed by exactly the same students
+ *     outcome_matrix tests results/HW_5                 tests by number of students failing them
+ */
+
+typedef uint64_t Word;
+
+class Bitset {
+public:
+    Bitset() {}
+
+    explicit Bitset(size_t bits) : _words((bits + 63) / 64, 0) {}
+
+    void set(size_t i) {
+        _words[i / 64] |= (Word) 1 << (i % 64);
+    }
+
+    bool test(size_t i) const {
+        return (_words[i / 64] >> (i % 64)) & 1;
+    }
+
+    bool intersects(const Bitset &other) const {
+        for (size_t w = 0; w < _words.size(); w++) {
+            if (_words[w] & other._words[w]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        for (Word w : _words) {
+            n += __builtin_popcountll(w);
+        }
+        return n;
+    }
+
+    bool operator<(const Bitset &other) const {
+        return _words < other._words;
+    }
+
+    vector<Word> &words() {
+        return _words;
+    }
+
+private:
+    vector<Word> _words;
+};
+
+/*!
+ * Glob match with '*' and '?', as in gtest filters
+ */
+bool glob(const char *pattern, const char *name) {
+    if (*pattern == '\0') {
+        return *name == '\0';
+    }
+    if (*pattern == '*') {
+        return glob(pattern + 1, name) || (*name && glob(pattern, name + 1));
+    }
+    return *name && (*pattern == '?' || *pattern == *name) && glob(pattern + 1, name + 1);
+}
+
+struct OutcomeMatrix {
+    vector<string> tests;    // column dictionary, sorted
+    vector<string> students; // logins, sorted
+    vector<Bitset> failed;   // one row per student
+
+    /*!
+     * Read every <login>.tsv in a results directory
+     */
+    static OutcomeMatrix from_results(const string &dir) {
+        OutcomeMatrix m;
+        std::map<string, std::map<string, bool>> passed; // login -> test -> passed
+        std::map<string, size_t> columns;
+        DIR *d = opendir(dir.c_str());
+        if (!d) {
+            throw std::runtime_error("Cannot open " + dir);
+        }
+        for (struct dirent *e = readdir(d); e; e = readdir(d)) {
+            string file = e->d_name, ext = RESULTS_EXT;
+            if (file.size() <= ext.size() || file.compare(file.size() - ext.size(), ext.size(), ext) != 0) {
+                continue;
+            }
+            std::map<string, bool> &row = passed[file.substr(0, file.size() - ext.size())];
+            std::ifstream in(dir + "/" + file);
+            string line;
+            while (std::getline(in, line)) {
+                std::istringstream fields(line);
+                string test, ok;
+                if (std::getline(fields, test, '\t') && std::getline(fields, ok, '\t')) {
+                    row[test] = ok == "1";
+                    columns[test] = 0;
+                }
+            }
+        }
+        closedir(d);
+
+        for (auto &c : columns) {
+            c.second = m.tests.size();
+            m.tests.push_back(c.first);
+        }
+        for (auto &row : passed) {
+            m.students.push_back(row.first);
+            Bitset bits(m.tests.size());
+            for (size_t j = 0; j < m.tests.size(); j++) {
+                auto t = row.second.find(m.tests[j]);
+                if (t == row.second.end() || !t->second) {
+                    bits.set(j);
+                }
+            }
+            m.failed.push_back(bits);
+        }
+        return m;
+    }
+
+    void save(const string &path) {
+        std::ofstream out(path, std::ios::binary);
+        out << MATRIX_MAGIC << "\n" << tests.size() << " " << students.size() << "\n";
+        for (const string &t : tests) {
+            out << t << "\n";
+        }
+        for (const string &s : students) {
+            out << s << "\n";
+        }
+        for (Bitset &row : failed) {
+            out.write((const char *) row.words().data(), row.words().size() * sizeof(Word));
+        }
+        if (!out) {
+            throw std::runtime_error("Cannot write " + path);
+        }
+    }
+
+    static OutcomeMatrix load(const string &path) {
+        OutcomeMatrix m;
+        std::ifstream in(path, std::ios::binary);
+        string magic;
+        size_t num_tests = 0, num_students = 0;
+        std::getline(in, magic);
+        in >> num_tests >> num_students;
+        in.ignore(1);
+        if (!in || magic != MATRIX_MAGIC) {
+            throw std::runtime_error("Not an outcome matrix: " + path + " (run 'outcome_matrix build' first)");
+        }
+        m.tests.resize(num_tests);
+        m.students.resize(num_students);
+        for (string &t : m.tests) {
+            std::getline(in, t);
+        }
+        for (string &s : m.students) {
+            std::getline(in, s);
+        }
+        for (size_t i = 0; i < num_students; i++) {
+            Bitset row(num_tests);
+            in.read((char *) row.words().data(), row.words().size() * sizeof(Word));
+            m.failed.push_back(row);
+        }
+        if (!in) {
+            throw std::runtime_error("Truncated outcome matrix: " + path);
+        }
+        return m;
+    }
+
+    Bitset columns_matching(const string &pattern) const {
+        Bitset mask(tests.size());
+        for (size_t j = 0; j < tests.size(); j++) {
+            if (glob(pattern.c_str(), tests[j].c_str())) {
+                mask.set(j);
+            }
+        }
+        return mask;
+    }
+
+    /*!
+     * The students failing a test, as a bitset over the rows
+     */
+    Bitset column(size_t j) const {
+        Bitset bits(students.size());
+        for (size_t i = 0; i < students.size(); i++) {
+            if (failed[i].test(j)) {
+                bits.set(i);
+            }
+        }
+        return bits;
+    }
+};
+
+void usage() {
+    std::cout << "Usage:" << std::endl
+              << "outcome_matrix build <results/HW>              pack <login>.tsv files into " MATRIX_FILE << std::endl
+              << "outcome_matrix failing <results/HW> <pattern>  students failing any test matching the pattern"
+              << std::endl
+              << "outcome_matrix same <results/HW>               groups of tests failed by the same students"
+              << std::endl
+              << "outcome_matrix tests <results/HW>              tests by the number of students failing them"
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    string command = argv[1], dir = argv[2], path = dir + "/" MATRIX_FILE;
+    try {
+        if (command == "build") {
+            OutcomeMatrix m = OutcomeMatrix::from_results(dir);
+            m.save(path);
+            std::cout << "Wrote " << path << ": " << m.students.size() << " students x " << m.tests.size()
+                      << " tests" << std::endl;
+        } else if (command == "failing" && argc >= 4) {
+            OutcomeMatrix m = OutcomeMatrix::load(path);
+            Bitset mask = m.columns_matching(argv[3]);
+            for (size_t i = 0; i < m.students.size(); i++) {
+                if (m.failed[i].intersects(mask)) {
+                    std::cout << m.students[i] << std::endl;
+                }
+            }
+        } else if (command == "same") {
+            OutcomeMatrix m = OutcomeMatrix::load(path);
+            std::map<Bitset, vector<size_t>> groups;
+            for (size_t j = 0; j < m.tests.size(); j++) {
+                groups[m.column(j)].push_back(j);
+            }
+            for (auto &g : groups) {
+                size_t failing = g.first.count();
+                if (g.second.size() > 1 && failing > 0) {
+                    std::cout << g.second.size() << " tests failed by the same " << failing << " students:"
+                              << std::endl;
+                    for (size_t j : g.second) {
+                        std::cout << "    " << m.tests[j] << std::endl;
+                    }
+                }
+            }
+        } else if (command == "tests") {
+            OutcomeMatrix m = OutcomeMatrix::load(path);
+            vector<std::pair<size_t, size_t>> counts; // failing students, test
+            for (size_t j = 0; j < m.tests.size(); j++) {
+                counts.push_back(std::make_pair(m.column(j).count(), j));
+            }
+            std::stable_sort(counts.begin(), counts.end(), [](const std::pair<size_t, size_t> &a,
+                                                              const std::pair<size_t, size_t> &b) {
+                return a.first > b.first;
+            });
+            for (auto &c : counts) {
+                std::cout << c.first << "\t" << m.tests[c.second] << std::endl;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    } catch (std::exception &e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}